@@ -10,16 +10,55 @@ CONFIG += c++17
 
 SOURCES += \
     main.cpp \
+    flowfield.cpp \
+    gamestate.cpp \
+    inputpolicy.cpp \
     mainwindow.cpp \
-    pacman.cpp
+    maze.cpp \
+    pacman.cpp \
+    replay.cpp \
+    profiler.cpp \
+    threadpool.cpp \
+    spatialhash.cpp \
+    inputqueue.cpp \
+    audio.cpp \
+    levelgen.cpp \
+    arena.cpp \
+    framewriter.cpp \
+    spritecache.cpp
 
 HEADERS += \
+    flowfield.h \
+    gamestate.h \
+    ghostbehavior.h \
+    inputpolicy.h \
     mainwindow.h \
-    pacman.h
+    maze.h \
+    builtinlevels.h \
+    pacman.h \
+    replay.h \
+    profiler.h \
+    threadpool.h \
+    spatialhash.h \
+    inputqueue.h \
+    audio.h \
+    levelgen.h \
+    arena.h \
+    varint.h \
+    framewriter.h \
+    spritecache.h
 
 FORMS += \
     mainwindow.ui
 
+# Sound output through Qt Multimedia when it is installed; without it the game runs silently
+qtHaveModule(multimedia) {
+    QT += multimedia
+    DEFINES += PACMAN_QT_AUDIO
+    SOURCES += qtaudiobackend.cpp
+    HEADERS += qtaudiobackend.h
+}
+
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
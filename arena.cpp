@@ -0,0 +1,531 @@
+#include "arena.h"
+#include <algorithm>
+#include "varint.h"
+
+namespace {
+
+const uint8_t flagPowerUp = 1;
+const uint8_t flagChecksum = 2;
+const int maskMoved = 1;
+const int maskScore = 2;
+const int maskLives = 4;
+const int maskLeft = 8;
+const int moveJump = 5; // Enemy moved other than one cell along an axis
+const uint64_t maxMessageBytes = 64 << 20;
+const uint64_t maxPlayerId = 1 << 16;
+
+bool fail(std::string *error, const std::string &message) {
+    if (error)
+        *error = message;
+    return false;
+}
+
+// Sorted cell indices as a count, the first index and the gaps between neighbors
+void writeCells(std::vector<uint8_t> &out, std::vector<int> cells) {
+    std::sort(cells.begin(), cells.end());
+    writeVarint(out, cells.size());
+    int previous = 0;
+    for (int cell : cells) {
+        writeVarint(out, static_cast<uint64_t>(cell - previous));
+        previous = cell;
+    }
+}
+
+bool isPellet(char cell) {
+    return cell == 'D' || cell == 'N';
+}
+
+int enemyMove(int dx, int dy) {
+    const int step = GameState::cellSize;
+    if (dy == 0 && (dx == step || dx == -step))
+        return dx > 0 ? 1 : 2;
+    if (dx == 0 && (dy == step || dy == -step))
+        return dy > 0 ? 3 : 4;
+    return dx == 0 && dy == 0 ? 0 : moveJump;
+}
+
+void mix(uint64_t &hash, int64_t value) {
+    // FNV-1a over the eight bytes of each value
+    for (int i = 0; i < 8; i++) {
+        hash ^= static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i));
+        hash *= 0x100000001B3ULL;
+    }
+}
+
+} // namespace
+
+Arena::Arena(const Level &level, uint64_t seed, int enemyCount)
+    : world(level, seed, enemyCount)
+{
+    markSent();
+}
+
+int Arena::addPlayer() {
+    size_t id = 0;
+    while (id < players.size() && players[id].active)
+        id++;
+    if (id == players.size())
+        players.emplace_back();
+
+    ArenaPlayer &player = players[id];
+    player = ArenaPlayer();
+    player.active = true;
+    player.lives = GameState::startLives;
+    respawnPlayer(player);
+    activePlayers++;
+    return static_cast<int>(id);
+}
+
+void Arena::removePlayer(int id) {
+    if (id < 0 || id >= static_cast<int>(players.size()) || !players[id].active)
+        return;
+    players[id].active = false;
+    activePlayers--;
+}
+
+void Arena::setInput(int id, Input input) {
+    if (id >= 0 && id < static_cast<int>(players.size()) && input != Input::None)
+        players[id].input = input;
+}
+
+void Arena::respawnPlayer(ArenaPlayer &player) {
+    Point spawn = world.getPacmanSpawn();
+    player.pacman = PacmanState();
+    player.pacman.x = spawn.x;
+    player.pacman.y = spawn.y;
+    player.pacman.setDirection(Input::Right);
+}
+
+void Arena::step() {
+    // Same order as GameState::step, with every rule applied to each player in id order
+    eatenCells.clear();
+    refilled = false;
+    world.beginStep();
+
+    const int speed = world.powerUpActive ? GameState::pacmanSpeed * 2 : GameState::pacmanSpeed;
+    const MazeView view = world.maze.view();
+    const ArenaPlayer *target = nullptr;
+    for (ArenaPlayer &player : players) {
+        if (!player.active)
+            continue;
+        player.pacman.speed = speed;
+        player.pacman.setDirection(player.input);
+        player.input = Input::None;
+        player.pacman.move(view, GameState::cellSize);
+        if (!target)
+            target = &player;
+    }
+
+    if (target)
+        world.pacman = target->pacman;
+    world.moveEnemies();
+
+    for (ArenaPlayer &player : players) {
+        if (!player.active)
+            continue;
+        int points = world.eatPellet(player.pacman);
+        if (points > 0) {
+            player.score += points;
+            eatenCells.push_back(world.eatenRow * world.maze.width() + world.eatenCol);
+        }
+    }
+    eatenSinceRefill.insert(eatenSinceRefill.end(), eatenCells.begin(), eatenCells.end());
+
+    for (ArenaPlayer &player : players) {
+        if (!player.active)
+            continue;
+        for (int i : world.findEnemyHits(player.pacman)) {
+            if (world.powerUpActive) {
+                world.respawnEnemy(i);
+            } else {
+                if (--player.lives <= 0) {
+                    player.score = 0;
+                    player.lives = GameState::startLives;
+                }
+                respawnPlayer(player);
+                break;
+            }
+        }
+    }
+
+    if (world.remainingDots == 0 && world.remainingPowerPellets == 0) {
+        const uint64_t tick = world.tick;
+        world.reset();
+        world.tick = tick;
+        eatenSinceRefill.clear();
+        refilled = true;
+    }
+}
+
+void Arena::markSent() {
+    sentPlayers = players;
+    sentEnemyX = world.enemies.x;
+    sentEnemyY = world.enemies.y;
+}
+
+void Arena::encodeState(std::vector<uint8_t> &out) const {
+    // The last broadcast state, so a client joining between ticks can apply the next delta
+    writeVarint(out, world.tick);
+    out.push_back(world.powerUpActive ? flagPowerUp : 0);
+    writeCells(out, eatenSinceRefill);
+
+    writeVarint(out, static_cast<uint64_t>(std::count_if(sentPlayers.begin(), sentPlayers.end(),
+                                                         [](const ArenaPlayer &p) { return p.active; })));
+    for (size_t id = 0; id < sentPlayers.size(); id++) {
+        const ArenaPlayer &player = sentPlayers[id];
+        if (!player.active)
+            continue;
+        writeVarint(out, id);
+        writeSignedVarint(out, player.pacman.x);
+        writeSignedVarint(out, player.pacman.y);
+        writeVarint(out, static_cast<uint64_t>(player.score));
+        writeVarint(out, static_cast<uint64_t>(player.lives));
+    }
+
+    writeVarint(out, sentEnemyX.size());
+    for (size_t i = 0; i < sentEnemyX.size(); i++) {
+        writeSignedVarint(out, sentEnemyX[i]);
+        writeSignedVarint(out, sentEnemyY[i]);
+    }
+}
+
+void Arena::encodeWelcome(int playerId, std::vector<uint8_t> &out) const {
+    out.clear();
+    writeVarint(out, static_cast<uint64_t>(playerId));
+    writeVarint(out, static_cast<uint64_t>(world.getTickRate()));
+    const Level &level = world.getLevel();
+    writeVarint(out, static_cast<uint64_t>(level.width));
+    writeVarint(out, static_cast<uint64_t>(level.height));
+    for (size_t i = 0; i < level.cells.size();) {
+        size_t run = 1;
+        while (i + run < level.cells.size() && level.cells[i + run] == level.cells[i])
+            run++;
+        out.push_back(static_cast<uint8_t>(level.cells[i]));
+        writeVarint(out, run);
+        i += run;
+    }
+    encodeState(out);
+}
+
+void Arena::encodeSnapshot(std::vector<uint8_t> &out) const {
+    out.clear();
+    encodeState(out);
+}
+
+bool Arena::encodeDelta(std::vector<uint8_t> &out) {
+    out.clear();
+    if (refilled) {
+        refilled = false;
+        markSent();
+        encodeState(out);
+        return false;
+    }
+
+    const bool checksum = world.tick % checksumInterval == 0;
+    writeVarint(out, world.tick);
+    out.push_back(static_cast<uint8_t>((world.powerUpActive ? flagPowerUp : 0) | (checksum ? flagChecksum : 0)));
+    writeCells(out, eatenCells);
+
+    // Players that joined since the last message are sent relative to an all-zero player
+    sentPlayers.resize(players.size());
+    std::vector<uint8_t> changes;
+    uint64_t changeCount = 0;
+    const ArenaPlayer none;
+    for (size_t id = 0; id < players.size(); id++) {
+        const ArenaPlayer &now = players[id];
+        const ArenaPlayer &was = sentPlayers[id].active ? sentPlayers[id] : none;
+        int mask = 0;
+        if (!now.active) {
+            mask = was.active ? maskLeft : 0;
+        } else {
+            mask |= now.pacman.x != was.pacman.x || now.pacman.y != was.pacman.y ? maskMoved : 0;
+            mask |= now.score != was.score ? maskScore : 0;
+            mask |= now.lives != was.lives ? maskLives : 0;
+        }
+        if (mask == 0)
+            continue;
+        changeCount++;
+        writeVarint(changes, id);
+        changes.push_back(static_cast<uint8_t>(mask));
+        if (mask & maskMoved) {
+            writeSignedVarint(changes, now.pacman.x - was.pacman.x);
+            writeSignedVarint(changes, now.pacman.y - was.pacman.y);
+        }
+        if (mask & maskScore)
+            writeSignedVarint(changes, now.score - was.score);
+        if (mask & maskLives)
+            writeVarint(changes, static_cast<uint64_t>(now.lives));
+    }
+    writeVarint(out, changeCount);
+    out.insert(out.end(), changes.begin(), changes.end());
+
+    // Enemies step one cell per tick, so nearly every move fits a nibble
+    const int count = world.enemies.size();
+    std::vector<int> jumps;
+    const size_t movesAt = out.size();
+    out.resize(movesAt + (count + 1) / 2, 0);
+    for (int i = 0; i < count; i++) {
+        int move = enemyMove(world.enemies.x[i] - sentEnemyX[i], world.enemies.y[i] - sentEnemyY[i]);
+        out[movesAt + i / 2] |= static_cast<uint8_t>(move << (4 * (i & 1)));
+        if (move == moveJump)
+            jumps.push_back(i);
+    }
+    for (int i : jumps) {
+        writeSignedVarint(out, world.enemies.x[i]);
+        writeSignedVarint(out, world.enemies.y[i]);
+    }
+
+    if (checksum) {
+        uint64_t hash = arenaChecksum(world.tick, players, world.enemies,
+                                      world.remainingDots + world.remainingPowerPellets);
+        for (int i = 0; i < 8; i++) {
+            out.push_back(static_cast<uint8_t>(hash >> (8 * i)));
+        }
+    }
+    markSent();
+    return true;
+}
+
+bool ArenaMirror::apply(ArenaMessage type, const std::vector<uint8_t> &payload, std::string *error) {
+    size_t pos = 0;
+    switch (type) {
+    case ArenaMessage::Welcome: {
+        uint64_t values[4];
+        for (uint64_t &value : values) {
+            if (!readVarint(payload, pos, value))
+                return fail(error, "truncated welcome");
+        }
+        if (values[0] >= maxPlayerId || !isSupportedLevelSize(values[2], values[3]))
+            return fail(error, "bad welcome header");
+        playerId = static_cast<int>(values[0]);
+        tickRate = static_cast<int>(values[1]);
+        startLevel.width = static_cast<int>(values[2]);
+        startLevel.height = static_cast<int>(values[3]);
+
+        const size_t cellCount = static_cast<size_t>(startLevel.width) * startLevel.height;
+        startLevel.cells.clear();
+        startLevel.cells.reserve(cellCount);
+        while (startLevel.cells.size() < cellCount) {
+            uint64_t run;
+            if (pos >= payload.size())
+                return fail(error, "truncated level in welcome");
+            char cell = static_cast<char>(payload[pos++]);
+            if (!readVarint(payload, pos, run) || run == 0 || run > cellCount - startLevel.cells.size())
+                return fail(error, "corrupt level run in welcome");
+            startLevel.cells.insert(startLevel.cells.end(), run, cell);
+        }
+        startPellets = static_cast<int>(std::count_if(startLevel.cells.begin(), startLevel.cells.end(), isPellet));
+        return applyState(payload, pos) || fail(error, "corrupt state in welcome");
+    }
+    case ArenaMessage::Snapshot:
+        if (startLevel.cells.empty())
+            return fail(error, "snapshot before welcome");
+        return applyState(payload, pos) || fail(error, "corrupt snapshot");
+    case ArenaMessage::Delta:
+        if (startLevel.cells.empty())
+            return fail(error, "delta before welcome");
+        return applyDelta(payload) || fail(error, "corrupt delta");
+    default:
+        return fail(error, "unexpected message");
+    }
+}
+
+bool ArenaMirror::eatCells(const std::vector<uint8_t> &payload, size_t &pos) {
+    uint64_t count;
+    if (!readVarint(payload, pos, count))
+        return false;
+    uint64_t cell = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t gap;
+        if (!readVarint(payload, pos, gap) || gap >= level.cells.size() - cell)
+            return false;
+        cell += gap;
+        if (isPellet(level.cells[cell]))
+            remainingPellets--;
+        level.cells[cell] = 'P';
+    }
+    return true;
+}
+
+ArenaPlayer *ArenaMirror::player(uint64_t id) {
+    if (id >= maxPlayerId)
+        return nullptr;
+    if (id >= players.size())
+        players.resize(id + 1);
+    return &players[id];
+}
+
+bool ArenaMirror::applyState(const std::vector<uint8_t> &payload, size_t &pos) {
+    level = startLevel;
+    remainingPellets = startPellets;
+    uint64_t count;
+    if (!readVarint(payload, pos, tick) || pos >= payload.size())
+        return false;
+    powerUpActive = (payload[pos++] & flagPowerUp) != 0;
+    if (!eatCells(payload, pos) || !readVarint(payload, pos, count))
+        return false;
+
+    for (ArenaPlayer &p : players) {
+        p.active = false;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t id, score, lives;
+        int64_t x, y;
+        ArenaPlayer *p;
+        if (!readVarint(payload, pos, id) || !(p = player(id)) || !readSignedVarint(payload, pos, x)
+            || !readSignedVarint(payload, pos, y) || !readVarint(payload, pos, score) || !readVarint(payload, pos, lives))
+            return false;
+        *p = ArenaPlayer();
+        p->active = true;
+        p->pacman.x = static_cast<int>(x);
+        p->pacman.y = static_cast<int>(y);
+        p->score = static_cast<int>(score);
+        p->lives = static_cast<int>(lives);
+    }
+
+    if (!readVarint(payload, pos, count) || count > payload.size())
+        return false;
+    enemies.resize(static_cast<int>(count));
+    for (uint64_t i = 0; i < count; i++) {
+        int64_t x, y;
+        if (!readSignedVarint(payload, pos, x) || !readSignedVarint(payload, pos, y))
+            return false;
+        enemies.x[i] = static_cast<int>(x);
+        enemies.y[i] = static_cast<int>(y);
+    }
+    return pos == payload.size();
+}
+
+bool ArenaMirror::applyDelta(const std::vector<uint8_t> &payload) {
+    size_t pos = 0;
+    uint64_t count;
+    if (!readVarint(payload, pos, tick) || pos >= payload.size())
+        return false;
+    const uint8_t flags = payload[pos++];
+    powerUpActive = (flags & flagPowerUp) != 0;
+    if (!eatCells(payload, pos) || !readVarint(payload, pos, count))
+        return false;
+
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t id;
+        ArenaPlayer *p;
+        if (!readVarint(payload, pos, id) || !(p = player(id)) || pos >= payload.size())
+            return false;
+        const int mask = payload[pos++];
+        if (mask & maskLeft) {
+            p->active = false;
+            continue;
+        }
+        if (!p->active) {
+            *p = ArenaPlayer();
+            p->active = true;
+        }
+        int64_t dx, dy, score;
+        uint64_t lives;
+        if (mask & maskMoved) {
+            if (!readSignedVarint(payload, pos, dx) || !readSignedVarint(payload, pos, dy))
+                return false;
+            p->pacman.x += static_cast<int>(dx);
+            p->pacman.y += static_cast<int>(dy);
+        }
+        if (mask & maskScore) {
+            if (!readSignedVarint(payload, pos, score))
+                return false;
+            p->score += static_cast<int>(score);
+        }
+        if (mask & maskLives) {
+            if (!readVarint(payload, pos, lives))
+                return false;
+            p->lives = static_cast<int>(lives);
+        }
+    }
+
+    const int enemyCount = enemies.size();
+    const size_t movesAt = pos;
+    pos += (enemyCount + 1) / 2;
+    if (pos > payload.size())
+        return false;
+    const int step = GameState::cellSize;
+    static const int moveDx[5] = {0, step, -step, 0, 0};
+    static const int moveDy[5] = {0, 0, 0, step, -step};
+    for (int i = 0; i < enemyCount; i++) {
+        int move = (payload[movesAt + i / 2] >> (4 * (i & 1))) & 0xf;
+        if (move == moveJump) {
+            int64_t x, y;
+            if (!readSignedVarint(payload, pos, x) || !readSignedVarint(payload, pos, y))
+                return false;
+            enemies.x[i] = static_cast<int>(x);
+            enemies.y[i] = static_cast<int>(y);
+        } else if (move < moveJump) {
+            enemies.x[i] += moveDx[move];
+            enemies.y[i] += moveDy[move];
+        } else {
+            return false;
+        }
+    }
+
+    if (flags & flagChecksum) {
+        if (payload.size() - pos != 8)
+            return false;
+        uint64_t expected = 0;
+        for (int i = 0; i < 8; i++) {
+            expected |= static_cast<uint64_t>(payload[pos++]) << (8 * i);
+        }
+        if (arenaChecksum(tick, players, enemies, remainingPellets) == expected) {
+            checksumsMatched++;
+        } else {
+            checksumMismatches++;
+        }
+    }
+    return pos == payload.size();
+}
+
+uint64_t arenaChecksum(uint64_t tick, const std::vector<ArenaPlayer> &players, const EnemyPool &enemies,
+                       int remainingPellets) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    mix(hash, static_cast<int64_t>(tick));
+    mix(hash, remainingPellets);
+    for (size_t id = 0; id < players.size(); id++) {
+        const ArenaPlayer &player = players[id];
+        if (!player.active)
+            continue;
+        mix(hash, static_cast<int64_t>(id));
+        mix(hash, player.pacman.x);
+        mix(hash, player.pacman.y);
+        mix(hash, player.score);
+        mix(hash, player.lives);
+    }
+    for (int i = 0; i < enemies.size(); i++) {
+        mix(hash, enemies.x[i]);
+        mix(hash, enemies.y[i]);
+    }
+    return hash;
+}
+
+void appendMessage(std::vector<uint8_t> &out, ArenaMessage type, const std::vector<uint8_t> &payload) {
+    writeVarint(out, payload.size() + 1);
+    out.push_back(static_cast<uint8_t>(type));
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+bool takeMessage(const std::vector<uint8_t> &in, size_t &pos, ArenaMessage &type, std::vector<uint8_t> &payload,
+                 std::string *error) {
+    size_t at = pos;
+    uint64_t length;
+    if (!readVarint(in, at, length)) {
+        // A length prefix never needs more than ten bytes
+        return in.size() - pos >= 10 ? fail(error, "corrupt message length") : false;
+    }
+    if (length == 0 || length > maxMessageBytes)
+        return fail(error, "bad message length");
+    if (in.size() - at < length)
+        return false;
+
+    type = static_cast<ArenaMessage>(in[at]);
+    if (type != ArenaMessage::Welcome && type != ArenaMessage::Snapshot && type != ArenaMessage::Delta
+        && type != ArenaMessage::Input)
+        return fail(error, "unknown message type");
+    payload.assign(in.begin() + at + 1, in.begin() + at + length);
+    pos = at + length;
+    return true;
+}
@@ -0,0 +1,114 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "gamestate.h"
+
+// Several Pacmans sharing one maze under the single-player rules: pellets, power-ups and enemies
+// belong to the world, every player has its own position, score and lives. Enemies chase the first
+// connected player. A player who runs out of lives starts over with a fresh score; the maze refills
+// once every pellet is gone.
+//
+// Protocol (all integers are LEB128 varints, signed ones zigzag-coded): each message is its length,
+// a type byte and the payload.
+//   Welcome  (server): player id, tick rate, level width, height, level cells as (byte, run) pairs,
+//                      then a Snapshot payload.
+//   Snapshot (server): tick, flags (1 = power-up), eaten cells since the last refill (first
+//                      absolute, then gaps), players as (id, x, y, score, lives), enemies as (x, y).
+//                      Sent instead of a Delta when the maze refills.
+//   Delta    (server): tick, flags (1 = power-up, 2 = checksum), cells eaten this tick (coded like
+//                      the snapshot), changed players as (id, mask, [dx, dy], [score change], [lives])
+//                      with mask 1 = moved, 2 = score, 4 = lives, 8 = left, then one 4-bit move per
+//                      enemy (0 = stay, 1..4 = one cell right/left/down/up, 5 = jump), two per byte,
+//                      then (x, y) for every jump, then a little-endian 64-bit checksum when flagged.
+//   Input    (client): one Input value, latched until the next tick.
+
+enum class ArenaMessage : uint8_t {
+    Welcome = 'W',
+    Snapshot = 'S',
+    Delta = 'D',
+    Input = 'I'
+};
+
+struct ArenaPlayer {
+    PacmanState pacman;
+    int score = 0;
+    int lives = 0;
+    Input input = Input::None; // Latest input, applied and cleared on the next step
+    bool active = false;
+};
+
+class Arena {
+public:
+    static const int checksumInterval = 32; // Deltas carry a checksum every this many ticks
+
+    Arena(const Level &level, uint64_t seed, int enemyCount = GameState::defaultEnemyCount);
+
+    int addPlayer(); // Spawn a new player, reusing free ids; returns its id
+    void removePlayer(int id);
+    void setInput(int id, Input input);
+    int playerCount() const { return activePlayers; }
+    void step();
+
+    void encodeWelcome(int playerId, std::vector<uint8_t> &out) const;
+    void encodeSnapshot(std::vector<uint8_t> &out) const;
+    // Changes since the previous encodeDelta or encodeSnapshot call; false when the maze was refilled
+    // during the last step, in which case 'out' holds a Snapshot instead
+    bool encodeDelta(std::vector<uint8_t> &out);
+
+    GameState world; // Maze, enemies and power-up; world.pacman is only the chase target
+    std::vector<ArenaPlayer> players; // Indexed by id
+    std::vector<int> eatenCells; // Cells (row * width + col) eaten during the last step
+
+private:
+    int activePlayers = 0;
+    bool refilled = false; // The last step refilled the maze
+    std::vector<int> eatenSinceRefill;
+    std::vector<ArenaPlayer> sentPlayers; // Player state as of the last encoded message
+    std::vector<int> sentEnemyX, sentEnemyY;
+
+    void respawnPlayer(ArenaPlayer &player);
+    void markSent();
+    void encodeState(std::vector<uint8_t> &out) const;
+};
+
+// Client-side copy of an arena, rebuilt from the server's messages
+class ArenaMirror {
+public:
+    bool apply(ArenaMessage type, const std::vector<uint8_t> &payload, std::string *error = nullptr);
+
+    int playerId = -1;
+    int tickRate = GameState::defaultTickRate;
+    Level level; // Eaten pellets turn into 'P' cells
+    uint64_t tick = 0;
+    bool powerUpActive = false;
+    std::vector<ArenaPlayer> players; // Indexed by id; only position, score, lives and active are kept
+    EnemyPool enemies; // Positions only
+    int remainingPellets = 0;
+    uint64_t checksumsMatched = 0;
+    uint64_t checksumMismatches = 0;
+
+private:
+    Level startLevel;
+    int startPellets = 0;
+
+    bool applyState(const std::vector<uint8_t> &payload, size_t &pos);
+    bool applyDelta(const std::vector<uint8_t> &payload);
+    bool eatCells(const std::vector<uint8_t> &payload, size_t &pos);
+    ArenaPlayer *player(uint64_t id);
+};
+
+// Hash of everything the protocol mirrors, compared by clients to detect desync
+uint64_t arenaChecksum(uint64_t tick, const std::vector<ArenaPlayer> &players, const EnemyPool &enemies,
+                       int remainingPellets);
+
+// Frame a message as length, type and payload
+void appendMessage(std::vector<uint8_t> &out, ArenaMessage type, const std::vector<uint8_t> &payload);
+// Take the next complete message starting at 'pos'; false when more bytes are needed, or with
+// 'error' set when the stream is corrupt
+bool takeMessage(const std::vector<uint8_t> &in, size_t &pos, ArenaMessage &type, std::vector<uint8_t> &payload,
+                 std::string *error = nullptr);
+
+#endif // ARENA_H
@@ -0,0 +1,326 @@
+#include "audio.h"
+#include "gamestate.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+const int mixRate = 22050; // The rate of the bundled sounds, so they normally play unresampled
+
+uint32_t readU32(const unsigned char *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+uint16_t readU16(const unsigned char *p) {
+    return static_cast<uint16_t>(p[0] | p[1] << 8);
+}
+
+void putU32(unsigned char *p, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+}
+
+void putU16(unsigned char *p, uint16_t value) {
+    p[0] = static_cast<unsigned char>(value);
+    p[1] = static_cast<unsigned char>(value >> 8);
+}
+
+bool fail(std::string *error, const std::string &message) {
+    if (error)
+        *error = message;
+    return false;
+}
+
+// Linear interpolation to the mix rate; good enough for short effects, and done once at load
+std::vector<int16_t> resample(const std::vector<int16_t> &input, int fromRate, int toRate) {
+    if (fromRate == toRate || input.empty())
+        return input;
+    size_t outputSize = static_cast<size_t>(static_cast<uint64_t>(input.size()) * toRate / fromRate);
+    std::vector<int16_t> output(outputSize);
+    for (size_t i = 0; i < outputSize; i++) {
+        double source = static_cast<double>(i) * fromRate / toRate;
+        size_t index = static_cast<size_t>(source);
+        double fraction = source - index;
+        int16_t a = input[std::min(index, input.size() - 1)];
+        int16_t b = input[std::min(index + 1, input.size() - 1)];
+        output[i] = static_cast<int16_t>(a + (b - a) * fraction);
+    }
+    return output;
+}
+
+} // namespace
+
+bool loadWav(const std::string &path, SoundClip &clip, std::string *error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return fail(error, "cannot open " + path);
+    std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (bytes.size() < 12 || std::memcmp(bytes.data(), "RIFF", 4) != 0 || std::memcmp(bytes.data() + 8, "WAVE", 4) != 0)
+        return fail(error, path + ": not a WAV file");
+
+    int channels = 0, rate = 0, bits = 0;
+    const unsigned char *data = nullptr;
+    size_t dataSize = 0;
+    for (size_t offset = 12; offset + 8 <= bytes.size();) {
+        const unsigned char *chunk = bytes.data() + offset;
+        size_t size = std::min<size_t>(readU32(chunk + 4), bytes.size() - offset - 8);
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            if (readU16(chunk + 8) != 1)
+                return fail(error, path + ": only uncompressed PCM is supported");
+            channels = readU16(chunk + 10);
+            rate = static_cast<int>(readU32(chunk + 12));
+            bits = readU16(chunk + 22);
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            data = chunk + 8;
+            dataSize = size;
+        }
+        offset += 8 + size + (size & 1); // Chunks are word aligned
+    }
+    if (!data || channels < 1 || rate <= 0 || (bits != 8 && bits != 16))
+        return fail(error, path + ": unsupported WAV format");
+
+    const int frameBytes = channels * bits / 8;
+    const size_t frames = dataSize / frameBytes;
+    std::vector<int16_t> mono(frames);
+    for (size_t f = 0; f < frames; f++) {
+        const unsigned char *frame = data + f * frameBytes;
+        int sum = 0;
+        for (int c = 0; c < channels; c++) {
+            sum += bits == 16 ? static_cast<int16_t>(readU16(frame + 2 * c)) : (frame[c] - 128) << 8;
+        }
+        mono[f] = static_cast<int16_t>(sum / channels);
+    }
+
+    clip.samples = resample(mono, rate, mixRate);
+    clip.sampleRate = mixRate;
+    return true;
+}
+
+bool NullAudioBackend::open(int sampleRate, std::string *) {
+    rate = sampleRate;
+    framesWritten = 0;
+    started = std::chrono::steady_clock::now();
+    return true;
+}
+
+void NullAudioBackend::write(const int16_t *, int count) {
+    pace(count);
+}
+
+void NullAudioBackend::resume() {
+    framesWritten = 0;
+    started = std::chrono::steady_clock::now();
+}
+
+void NullAudioBackend::pace(int count) {
+    // Sleep to the end of the previous block: one block is always queued ahead, like a device buffer
+    std::this_thread::sleep_until(started + std::chrono::microseconds(framesWritten * 1000000 / rate));
+    framesWritten += count;
+}
+
+WavFileAudioBackend::~WavFileAudioBackend() {
+    close();
+}
+
+bool WavFileAudioBackend::open(int sampleRate, std::string *error) {
+    file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return fail(error, "cannot open " + path);
+    rate = sampleRate;
+    dataBytes = 0;
+    writeHeader();
+    return NullAudioBackend::open(sampleRate, error);
+}
+
+void WavFileAudioBackend::write(const int16_t *samples, int count) {
+    if (realTime)
+        pace(count);
+    if (!file)
+        return;
+    for (int i = 0; i < count; i++) {
+        unsigned char bytes[2];
+        putU16(bytes, static_cast<uint16_t>(samples[i]));
+        std::fwrite(bytes, 1, 2, file);
+    }
+    dataBytes += static_cast<uint32_t>(count) * 2;
+}
+
+void WavFileAudioBackend::close() {
+    if (!file)
+        return;
+    std::fseek(file, 0, SEEK_SET);
+    writeHeader(); // Now with the final sizes
+    std::fclose(file);
+    file = nullptr;
+}
+
+void WavFileAudioBackend::writeHeader() {
+    unsigned char header[44];
+    std::memcpy(header, "RIFF", 4);
+    putU32(header + 4, 36 + dataBytes);
+    std::memcpy(header + 8, "WAVEfmt ", 8);
+    putU32(header + 16, 16);
+    putU16(header + 20, 1); // PCM
+    putU16(header + 22, 1); // Mono
+    putU32(header + 24, static_cast<uint32_t>(rate));
+    putU32(header + 28, static_cast<uint32_t>(rate) * 2);
+    putU16(header + 32, 2);
+    putU16(header + 34, 16);
+    std::memcpy(header + 36, "data", 4);
+    putU32(header + 40, dataBytes);
+    std::fwrite(header, 1, sizeof(header), file);
+}
+
+AudioEngine::AudioEngine()
+    : sampleRate(mixRate), running(false), paused(false), requestHead(0), requestTail(0), mixedFrames(0), dropped(0) {}
+
+AudioEngine::~AudioEngine() {
+    stop();
+}
+
+bool AudioEngine::loadSounds(const std::string &directory, std::string *error) {
+    static const char *const files[static_cast<int>(Sound::Count)] = {
+        "1_soundDead.wav", "2_soundGhost.wav", "3_soundFood.wav", "4_soundPower.wav"};
+    std::string prefix = directory.empty() || directory.back() == '/' ? directory : directory + "/";
+    for (int s = 0; s < static_cast<int>(Sound::Count); s++) {
+        if (!loadWav(prefix + files[s], clips[s], error))
+            return false;
+    }
+    return true;
+}
+
+bool AudioEngine::start(std::unique_ptr<AudioBackend> output, std::string *error) {
+    stop();
+    if (!output)
+        return fail(error, "no audio backend");
+    if (!output->open(sampleRate, error))
+        return false;
+    backend = std::move(output);
+    for (Voice &voice : voices) {
+        voice = Voice();
+    }
+    requestHead.store(requestTail.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    running.store(true, std::memory_order_relaxed);
+    mixer = std::thread(&AudioEngine::run, this);
+    return true;
+}
+
+void AudioEngine::stop() {
+    if (!mixer.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        running.store(false, std::memory_order_relaxed);
+    }
+    wake.notify_one();
+    mixer.join();
+    backend->close();
+    backend.reset();
+}
+
+void AudioEngine::play(Sound sound) {
+    if (!isRunning())
+        return;
+    uint32_t tail = requestTail.load(std::memory_order_relaxed);
+    if (tail - requestHead.load(std::memory_order_acquire) >= static_cast<uint32_t>(queueSize)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    requests[tail % queueSize] = static_cast<uint8_t>(sound);
+    requestTail.store(tail + 1, std::memory_order_release);
+}
+
+void AudioEngine::playEvents(uint8_t stepEvents) {
+    // A death drowns out everything else that happened on the same step
+    if (stepEvents & EventDeath) {
+        play(Sound::Death);
+        return;
+    }
+    if (stepEvents & EventGhostEaten)
+        play(Sound::GhostEaten);
+    if (stepEvents & EventPowerPellet)
+        play(Sound::Power);
+    else if (stepEvents & EventDot)
+        play(Sound::Food);
+}
+
+void AudioEngine::setPaused(bool pause) {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        paused.store(pause, std::memory_order_relaxed);
+    }
+    wake.notify_one();
+}
+
+void AudioEngine::run() {
+    int16_t block[blockFrames];
+    int32_t accumulator[blockFrames];
+    while (running.load(std::memory_order_relaxed)) {
+        uint32_t tail = requestTail.load(std::memory_order_acquire);
+        uint32_t head = requestHead.load(std::memory_order_relaxed);
+        for (; head != tail; head++) {
+            startVoice(static_cast<Sound>(requests[head % queueSize]));
+        }
+        requestHead.store(head, std::memory_order_release);
+
+        if (paused.load(std::memory_order_relaxed)
+            && std::none_of(voices, voices + maxVoices, [](const Voice &voice) { return voice.clip != nullptr; })) {
+            backend->suspend();
+            {
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                wake.wait(lock, [this] {
+                    return !paused.load(std::memory_order_relaxed) || !running.load(std::memory_order_relaxed);
+                });
+            }
+            backend->resume();
+            continue;
+        }
+
+        mix(block, accumulator, blockFrames);
+        backend->write(block, blockFrames); // Blocks until the device (or its stand-in) wants more
+        mixedFrames.fetch_add(blockFrames, std::memory_order_relaxed);
+    }
+}
+
+void AudioEngine::startVoice(Sound sound) {
+    if (sound >= Sound::Count)
+        return;
+    const SoundClip *clip = &clips[static_cast<int>(sound)];
+    if (clip->samples.empty())
+        return;
+
+    // A free voice if there is one, otherwise the one furthest through its clip
+    Voice *target = &voices[0];
+    for (Voice &voice : voices) {
+        if (!voice.clip) {
+            target = &voice;
+            break;
+        }
+        if (voice.position > target->position)
+            target = &voice;
+    }
+    target->clip = clip;
+    target->position = 0;
+}
+
+void AudioEngine::mix(int16_t *out, int32_t *accumulator, int count) {
+    std::fill(accumulator, accumulator + count, 0);
+    for (Voice &voice : voices) {
+        if (!voice.clip)
+            continue;
+        const std::vector<int16_t> &samples = voice.clip->samples;
+        int n = static_cast<int>(std::min<size_t>(count, samples.size() - voice.position));
+        const int16_t *source = samples.data() + voice.position;
+        for (int i = 0; i < n; i++) {
+            accumulator[i] += source[i];
+        }
+        voice.position += n;
+        if (voice.position >= samples.size())
+            voice.clip = nullptr;
+    }
+    for (int i = 0; i < count; i++) {
+        out[i] = static_cast<int16_t>(std::max(-32768, std::min(32767, accumulator[i])));
+    }
+}
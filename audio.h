@@ -0,0 +1,141 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Sound effects, in the order of the numbered files in Resources/PacManAdvancedSounds
+enum class Sound : uint8_t {
+    Death,
+    GhostEaten,
+    Food,
+    Power,
+    Count
+};
+
+// Decoded mono 16-bit PCM
+struct SoundClip {
+    std::vector<int16_t> samples;
+    int sampleRate = 0;
+};
+
+// Reads an uncompressed PCM WAV (8 or 16 bit, any channel count, mixed down to mono)
+bool loadWav(const std::string &path, SoundClip &clip, std::string *error = nullptr);
+
+// Where the mixed audio goes. write() runs on the mixer thread and may block: that is what
+// paces the mixer to real time
+class AudioBackend {
+public:
+    virtual ~AudioBackend() = default;
+    virtual bool open(int sampleRate, std::string *error) = 0;
+    virtual void write(const int16_t *samples, int count) = 0; // Mono frames
+    virtual void close() {}
+    // The mixer goes to sleep after suspend() and writes nothing until resume() (mixer thread)
+    virtual void suspend() {}
+    virtual void resume() {}
+};
+
+// Discards the mix at the pace a sound card would consume it, for machines without audio
+class NullAudioBackend : public AudioBackend {
+public:
+    bool open(int sampleRate, std::string *error) override;
+    void write(const int16_t *samples, int count) override;
+    void resume() override; // Time spent suspended is not made up for
+
+protected:
+    void pace(int count); // Sleep until 'count' more frames would have been played
+
+private:
+    int rate = 0;
+    uint64_t framesWritten = 0;
+    std::chrono::steady_clock::time_point started;
+};
+
+// Records the mix to a WAV file (paced like a sound card unless realTime is false), so
+// sound triggering can be checked on headless CI machines
+class WavFileAudioBackend : public NullAudioBackend {
+public:
+    explicit WavFileAudioBackend(const std::string &path, bool realTime = true) : path(path), realTime(realTime) {}
+    ~WavFileAudioBackend() override;
+    bool open(int sampleRate, std::string *error) override;
+    void write(const int16_t *samples, int count) override;
+    void close() override;
+
+private:
+    std::string path;
+    bool realTime;
+    FILE *file = nullptr;
+    uint32_t dataBytes = 0;
+    int rate = 0;
+
+    void writeHeader();
+};
+
+// Plays sound effects without ever blocking the caller: play() pushes onto a lock-free
+// single-producer queue, and a mixer thread drains it, mixes the active voices in small
+// blocks and hands them to the backend. Clips are decoded once, up front
+class AudioEngine {
+public:
+    static const int blockFrames = 256; // About 12 ms at 22050 Hz
+    static const int maxVoices = 16; // Oldest voice is replaced beyond this
+    static const int queueSize = 64; // Play requests beyond this are dropped
+
+    AudioEngine();
+    ~AudioEngine();
+
+    AudioEngine(const AudioEngine &) = delete;
+    AudioEngine &operator=(const AudioEngine &) = delete;
+
+    // Loads 1_soundDead.wav, 2_soundGhost.wav, 3_soundFood.wav and 4_soundPower.wav
+    bool loadSounds(const std::string &directory, std::string *error = nullptr);
+    bool start(std::unique_ptr<AudioBackend> output, std::string *error = nullptr);
+    void stop();
+    bool isRunning() const { return mixer.joinable(); }
+
+    void play(Sound sound); // Game thread only; never blocks or allocates
+    void playEvents(uint8_t stepEvents); // Sounds for GameState::events
+    // Paused, the mixer plays out the sounds already requested, then sleeps without waking until
+    // unpaused; sounds requested meanwhile start then
+    void setPaused(bool paused);
+
+    uint64_t framesMixed() const { return mixedFrames.load(std::memory_order_relaxed); }
+    uint64_t droppedRequests() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Voice {
+        const SoundClip *clip = nullptr;
+        size_t position = 0;
+    };
+
+    SoundClip clips[static_cast<int>(Sound::Count)];
+    int sampleRate;
+    std::unique_ptr<AudioBackend> backend;
+    std::thread mixer;
+    std::atomic<bool> running;
+    std::atomic<bool> paused;
+    std::mutex wakeMutex; // Guards the changes of running and paused the sleeping mixer waits for
+    std::condition_variable wake;
+
+    // Single-producer/single-consumer ring of play requests
+    uint8_t requests[queueSize];
+    std::atomic<uint32_t> requestHead; // Next slot the mixer reads
+    std::atomic<uint32_t> requestTail; // Next slot play() writes
+
+    Voice voices[maxVoices]; // Mixer thread only
+    std::atomic<uint64_t> mixedFrames;
+    std::atomic<uint64_t> dropped;
+
+    void run();
+    void startVoice(Sound sound);
+    void mix(int16_t *out, int32_t *accumulator, int count);
+};
+
+#endif // AUDIO_H
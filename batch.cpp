@@ -0,0 +1,227 @@
+// batch.cpp - headless self-play runner: plays many independent games across all cores
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "gamestate.h"
+#include "inputpolicy.h"
+#include "levelgen.h"
+#include "threadpool.h"
+
+namespace {
+
+struct BatchOptions {
+    uint64_t firstSeed = 0;
+    uint64_t lastSeed = 999; // Inclusive
+    int threads = 0; // 0 = all cores
+    int enemies = GameState::defaultEnemyCount;
+    int maxTicks = 100000; // Games still running after this many ticks count as timed out
+    std::string policy = "greedy";
+    std::string levelPath;
+    int generateWidth = 0; // Non-zero: every game gets its own generated level, seeded like the game
+    int generateHeight = 0;
+    GhostPolicy ghostPolicy = GhostPolicy::Random;
+    bool ghostSeparation = false;
+    int activeRadius = 0;
+    double minAvgTicks = 0; // Fail (exit status 2) when games last fewer ticks than this on average
+};
+
+struct GameResult {
+    int score = 0;
+    int livesLost = 0;
+    uint64_t ticks = 0;
+    bool cleared = false;
+    int catches[ghostPersonalityCount] = {}; // Lives lost to each ghost personality (Personalities policy)
+    uint64_t catchTicks[ghostPersonalityCount] = {}; // Sum of the ticks those lives were lost at
+};
+
+void printUsage(const char *program) {
+    std::printf("Usage: %s [options]\n"
+                "  --seeds A:B        Seed range, inclusive (default 0:999)\n"
+                "  --threads N        Worker threads (default: all cores)\n"
+                "  --policy NAME      Input policy: none, random, greedy, search (default greedy)\n"
+                "  --level PATH       Level file instead of the built-in maze\n"
+                "  --generate WxH     A generated WxH level per game, from the game's seed\n"
+                "  --enemies N        Number of enemies (default %d)\n"
+                "  --ghost-ai NAME    random, chase or personalities (default random)\n"
+                "  --separate         Keep enemies from stepping onto each other\n"
+                "  --active-radius N  Only simulate enemies within N maze chunks of Pacman (default 0 = all)\n"
+                "  --max-ticks N      Tick limit per game (default 100000)\n"
+                "  --min-avg-ticks N  Exit with status 2 if games last fewer ticks than this on average\n",
+                program, GameState::defaultEnemyCount);
+}
+
+bool parseOptions(int argc, char *argv[], BatchOptions &options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--separate") {
+            options.ghostSeparation = true;
+            continue;
+        }
+        if (arg == "--help" || arg == "-h" || i + 1 >= argc)
+            return false;
+        std::string value = argv[++i];
+        if (arg == "--seeds") {
+            size_t colon = value.find(':');
+            options.firstSeed = std::strtoull(value.c_str(), nullptr, 10);
+            options.lastSeed = colon == std::string::npos ? options.firstSeed
+                                                          : std::strtoull(value.c_str() + colon + 1, nullptr, 10);
+        } else if (arg == "--threads") {
+            options.threads = std::atoi(value.c_str());
+        } else if (arg == "--policy") {
+            options.policy = value;
+        } else if (arg == "--level") {
+            options.levelPath = value;
+        } else if (arg == "--generate") {
+            size_t x = value.find('x');
+            options.generateWidth = std::atoi(value.c_str());
+            options.generateHeight = x == std::string::npos ? options.generateWidth : std::atoi(value.c_str() + x + 1);
+            if (options.generateWidth <= 0 || options.generateHeight <= 0)
+                return false;
+        } else if (arg == "--enemies") {
+            options.enemies = std::max(0, std::atoi(value.c_str()));
+        } else if (arg == "--ghost-ai") {
+            options.ghostPolicy = value == "chase" ? GhostPolicy::ChaseScatter
+                : value == "personalities" ? GhostPolicy::Personalities : GhostPolicy::Random;
+        } else if (arg == "--active-radius") {
+            options.activeRadius = std::max(0, std::atoi(value.c_str()));
+        } else if (arg == "--max-ticks") {
+            options.maxTicks = std::max(1, std::atoi(value.c_str()));
+        } else if (arg == "--min-avg-ticks") {
+            options.minAvgTicks = std::atof(value.c_str());
+        } else {
+            return false;
+        }
+    }
+    // The full 64-bit range holds 2^64 games, one more than the uint64_t game count can hold
+    return options.lastSeed >= options.firstSeed && options.lastSeed - options.firstSeed < UINT64_MAX;
+}
+
+GameResult playGame(const Level &level, const BatchOptions &options, uint64_t seed) {
+    GameState game(level, seed, options.enemies);
+    game.ghostPolicy = options.ghostPolicy;
+    game.ghostSeparation = options.ghostSeparation;
+    game.activeRadius = options.activeRadius;
+    game.reset();
+    std::unique_ptr<InputPolicy> policy;
+    if (options.policy == "search") {
+        // A fixed number of rollouts per move instead of a time budget, so results do not depend
+        // on the machine or its load
+        SearchSettings settings;
+        settings.budgetMs = 0;
+        policy.reset(new SearchPolicy(seed ^ 0x9E3779B97F4A7C15ULL, settings));
+    } else {
+        policy = makeInputPolicy(options.policy, seed ^ 0x9E3779B97F4A7C15ULL);
+    }
+
+    GameResult result;
+    while (!game.isOver() && game.tick < static_cast<uint64_t>(options.maxTicks)) {
+        game.step(policy->decide(game));
+        if (game.caughtBy >= 0) {
+            const int personality = game.caughtBy % ghostPersonalityCount;
+            result.catches[personality]++;
+            result.catchTicks[personality] += game.tick;
+        }
+    }
+
+    result.score = game.score;
+    result.livesLost = GameState::startLives - std::max(0, game.lives);
+    result.ticks = game.tick;
+    result.cleared = game.won;
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    BatchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (!makeInputPolicy(options.policy, 0)) {
+        std::fprintf(stderr, "Unknown policy: %s\n", options.policy.c_str());
+        return 1;
+    }
+
+    Level level = defaultLevel();
+    if (!options.levelPath.empty()) {
+        std::string error;
+        if (!loadLevelFile(options.levelPath, level, &error)) {
+            std::fprintf(stderr, "Could not load level: %s\n", error.c_str());
+            return 1;
+        }
+    }
+
+    const uint64_t gameCount = options.lastSeed - options.firstSeed + 1;
+    std::vector<GameResult> results(gameCount);
+    auto start = std::chrono::steady_clock::now();
+    {
+        ThreadPool pool(options.threads);
+        for (uint64_t i = 0; i < gameCount; i++) {
+            pool.submit([&, i]() {
+                const uint64_t seed = options.firstSeed + i;
+                results[i] = options.generateWidth > 0
+                                 ? playGame(generateLevel(options.generateWidth, options.generateHeight, seed), options, seed)
+                                 : playGame(level, options, seed);
+            });
+        }
+        pool.wait();
+        options.threads = pool.size();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    long long totalScore = 0;
+    long long totalLivesLost = 0;
+    long long totalTicks = 0;
+    long long clearTicks = 0;
+    int cleared = 0;
+    int bestScore = 0;
+    long long catches[ghostPersonalityCount] = {};
+    long long catchTicks[ghostPersonalityCount] = {};
+    for (const GameResult &result : results) {
+        for (int p = 0; p < ghostPersonalityCount; p++) {
+            catches[p] += result.catches[p];
+            catchTicks[p] += static_cast<long long>(result.catchTicks[p]);
+        }
+        totalScore += result.score;
+        totalLivesLost += result.livesLost;
+        totalTicks += static_cast<long long>(result.ticks);
+        bestScore = std::max(bestScore, result.score);
+        if (result.cleared) {
+            cleared++;
+            clearTicks += static_cast<long long>(result.ticks);
+        }
+    }
+
+    const double games = static_cast<double>(gameCount);
+    std::printf("games            %llu (seeds %llu..%llu, policy %s, %d threads)\n",
+                static_cast<unsigned long long>(gameCount), static_cast<unsigned long long>(options.firstSeed),
+                static_cast<unsigned long long>(options.lastSeed), options.policy.c_str(), options.threads);
+    std::printf("score            avg %.1f, best %d\n", totalScore / games, bestScore);
+    std::printf("lives lost       avg %.2f\n", totalLivesLost / games);
+    std::printf("cleared          %d (%.1f%%)\n", cleared, 100.0 * cleared / games);
+    if (cleared > 0)
+        std::printf("ticks to clear   avg %.1f\n", static_cast<double>(clearTicks) / cleared);
+    std::printf("ticks            %lld total, avg %.1f per game\n", totalTicks, totalTicks / games);
+    if (options.ghostPolicy == GhostPolicy::Personalities) {
+        // Which personalities catch Pacman, and how long he lasts against each
+        for (int p = 0; p < ghostPersonalityCount; p++) {
+            std::printf("%-16s %lld lives", p == 0 ? "caught by" : "", catches[p]);
+            if (catches[p] > 0)
+                std::printf(", avg tick %.1f", static_cast<double>(catchTicks[p]) / catches[p]);
+            std::printf(" (%s)\n", ghostPersonalities[p].name);
+        }
+    }
+    std::printf("throughput       %.1f games/s, %.0f ticks/s (%.3f s)\n", games / seconds, totalTicks / seconds, seconds);
+    if (totalTicks / games < options.minAvgTicks) {
+        std::fprintf(stderr, "Games lasted %.1f ticks on average, expected at least %.1f\n", totalTicks / games,
+                     options.minAvgTicks);
+        return 2;
+    }
+    return 0;
+}
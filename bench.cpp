@@ -0,0 +1,202 @@
+// bench.cpp - engine microbenchmarks (Google Benchmark)
+// Run with --benchmark_format=json or --benchmark_out=FILE --benchmark_out_format=json to track regressions
+#include <benchmark/benchmark.h>
+#include <vector>
+#include "gamestate.h"
+#include "benchlevel.h"
+#include "levelgen.h"
+
+namespace {
+
+const int maxSize = 2000;
+
+// Maze sizes from the built-in 20x20 up to 2000x2000
+void sizeArgs(benchmark::internal::Benchmark *bench) {
+    for (int size = 20; size <= maxSize; size *= 10) {
+        bench->Arg(size);
+    }
+}
+
+// Maze sizes crossed with 3 to 10k enemies
+void sizeEnemyArgs(benchmark::internal::Benchmark *bench) {
+    for (int size = 20; size <= maxSize; size *= 10) {
+        for (int enemies : {3, 100, 1000, 10000}) {
+            bench->Args({size, enemies});
+        }
+    }
+}
+
+// Random open cell centers, so lookups do not walk memory sequentially
+std::vector<Point> openCenters(const Maze &maze, int limit) {
+    std::vector<Point> centers;
+    Rng rng(7);
+    while (static_cast<int>(centers.size()) < limit) {
+        int row = rng.bounded(maze.height());
+        int col = rng.bounded(maze.width());
+        if (maze.at(row, col) != MazeItem::Wall) {
+            centers.push_back(Point{col * GameState::cellSize + GameState::cellSize / 2,
+                                    row * GameState::cellSize + GameState::cellSize / 2});
+        }
+    }
+    return centers;
+}
+
+void BM_PacmanMove(benchmark::State &state) {
+    GameState game(benchLevel(static_cast<int>(state.range(0))), 1);
+    const MazeView view = game.maze.view();
+    PacmanState pacman = game.pacman;
+    Rng rng(3);
+    const Input turns[4] = {Input::Up, Input::Down, Input::Left, Input::Right};
+
+    for (auto _ : state) {
+        int oldX = pacman.x;
+        int oldY = pacman.y;
+        pacman.move(view, GameState::cellSize);
+        if (pacman.x == oldX && pacman.y == oldY) {
+            pacman.setDirection(turns[rng.bounded(4)]);
+        }
+        benchmark::DoNotOptimize(pacman);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PacmanMove)->Apply(sizeArgs);
+
+// General rectangle test, as used for off-center movement
+void BM_CheckWallCollision(benchmark::State &state) {
+    GameState game(benchLevel(static_cast<int>(state.range(0))), 1);
+    const MazeView view = game.maze.view();
+    const std::vector<Point> centers = openCenters(game.maze, 4096);
+    const int half = 15; // Enemy-sized box
+    size_t i = 0;
+
+    for (auto _ : state) {
+        const Point &p = centers[i++ & 4095];
+        benchmark::DoNotOptimize(checkWallCollision(p.x - half, p.y - half, 2 * half, 2 * half,
+                                                    view, GameState::cellSize));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CheckWallCollision)->Apply(sizeArgs);
+
+// Exit-mask fast path taken at cell centers
+void BM_IsBlocked(benchmark::State &state) {
+    GameState game(benchLevel(static_cast<int>(state.range(0))), 1);
+    const MazeView view = game.maze.view();
+    const std::vector<Point> centers = openCenters(game.maze, 4096);
+    const int steps[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    PacmanState pacman;
+    size_t i = 0;
+
+    for (auto _ : state) {
+        const Point &p = centers[i & 4095];
+        const int *s = steps[i & 3];
+        pacman.x = p.x;
+        pacman.y = p.y;
+        benchmark::DoNotOptimize(pacman.isBlocked(s[0] * pacman.speed, s[1] * pacman.speed, view, GameState::cellSize));
+        i++;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_IsBlocked)->Apply(sizeArgs);
+
+// One full simulation tick: Pacman movement, pellet lookup, enemy turns and movement, collisions.
+// Pacman wanders randomly so pellets get eaten and the chase field gets recomputed
+void runSteps(benchmark::State &state, GhostPolicy policy, bool separation = false, int activeRadius = 0) {
+    const int enemies = static_cast<int>(state.range(1));
+    GameState game(benchLevel(static_cast<int>(state.range(0))), 1, enemies);
+    game.ghostPolicy = policy;
+    game.ghostSeparation = separation;
+    game.activeRadius = activeRadius;
+    game.reset();
+    Rng rng(5);
+    const Input turns[4] = {Input::Up, Input::Down, Input::Left, Input::Right};
+
+    for (auto _ : state) {
+        if (game.isOver()) {
+            state.PauseTiming();
+            game.reset();
+            state.ResumeTiming();
+        }
+        game.step((game.tick & 7) == 0 ? turns[rng.bounded(4)] : Input::None);
+    }
+    state.SetItemsProcessed(state.iterations() * enemies); // Enemy updates per second
+    state.counters["ticks_per_second"] = benchmark::Counter(static_cast<double>(state.iterations()),
+                                                            benchmark::Counter::kIsRate);
+}
+
+void BM_StepRandomGhosts(benchmark::State &state) {
+    runSteps(state, GhostPolicy::Random);
+}
+BENCHMARK(BM_StepRandomGhosts)->Apply(sizeEnemyArgs);
+
+void BM_StepChaseGhosts(benchmark::State &state) {
+    runSteps(state, GhostPolicy::ChaseScatter);
+}
+BENCHMARK(BM_StepChaseGhosts)->Apply(sizeEnemyArgs);
+
+// Ghost personalities: one steering pass per behavior group, so the cost per enemy should stay
+// close to the chase ghosts' as the enemy count grows
+void BM_StepPersonalityGhosts(benchmark::State &state) {
+    runSteps(state, GhostPolicy::Personalities);
+}
+BENCHMARK(BM_StepPersonalityGhosts)->Apply(sizeEnemyArgs);
+
+// Random ghosts kept apart through the per-tick spatial hash, which also answers Pacman's collisions
+void BM_StepSeparatedGhosts(benchmark::State &state) {
+    runSteps(state, GhostPolicy::Random, true);
+}
+BENCHMARK(BM_StepSeparatedGhosts)->Apply(sizeEnemyArgs);
+
+// Chase ghosts with only the chunks around Pacman simulated: per-tick cost follows the active
+// area, not the maze size
+void BM_StepActiveChunks(benchmark::State &state) {
+    runSteps(state, GhostPolicy::ChaseScatter, false, 1);
+}
+BENCHMARK(BM_StepActiveChunks)->Apply(sizeEnemyArgs);
+
+// Save and rewind the whole game state, as a lookahead search or rollback would each tick;
+// the maze tiles are shared, so only the tile Pacman eats from gets copied
+void BM_SnapshotRestore(benchmark::State &state) {
+    const int enemies = static_cast<int>(state.range(1));
+    GameState game(benchLevel(static_cast<int>(state.range(0))), 1, enemies);
+    for (auto _ : state) {
+        GameSnapshot saved = game.snapshot();
+        game.step(Input::Down);
+        game.restore(saved);
+    }
+}
+BENCHMARK(BM_SnapshotRestore)->Apply(sizeEnemyArgs);
+
+// Restarting a game: the built maze is shared again, so this is cheap even on large levels
+void BM_Reset(benchmark::State &state) {
+    GameState game(benchLevel(static_cast<int>(state.range(0))), 1);
+    for (auto _ : state) {
+        game.reset();
+        benchmark::DoNotOptimize(game.remainingDots);
+    }
+}
+BENCHMARK(BM_Reset)->Apply(sizeArgs)->Unit(benchmark::kMicrosecond);
+
+// Generating a fresh level and checking that every pellet is reachable from the start
+void BM_GenerateLevel(benchmark::State &state) {
+    const int size = static_cast<int>(state.range(0));
+    uint64_t seed = 0;
+    for (auto _ : state) {
+        Level level = generateLevel(size, size, seed++);
+        benchmark::DoNotOptimize(level.cells.data());
+    }
+    state.SetItemsProcessed(state.iterations() * size * size); // Cells per second
+}
+BENCHMARK(BM_GenerateLevel)->Apply(sizeArgs)->Unit(benchmark::kMillisecond);
+
+void BM_CheckLevelReachable(benchmark::State &state) {
+    Level level = generateLevel(static_cast<int>(state.range(0)), static_cast<int>(state.range(0)), 1);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(unreachableCells(level));
+    }
+}
+BENCHMARK(BM_CheckLevelReachable)->Apply(sizeArgs)->Unit(benchmark::kMillisecond);
+
+} // namespace
+
+BENCHMARK_MAIN();
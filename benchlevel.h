@@ -0,0 +1,32 @@
+#ifndef BENCHLEVEL_H
+#define BENCHLEVEL_H
+
+#include "maze.h"
+
+// Open square maze of any size for the benchmarks: border walls, scattered pillars, dots everywhere else.
+// Enemy spawns are spread over a grid so large enemy counts do not all start on one cell.
+// A 20x20 maze uses the built-in level instead
+inline Level benchLevel(int size) {
+    if (size == 20)
+        return defaultLevel();
+
+    Level level;
+    level.width = size;
+    level.height = size;
+    level.cells.assign(static_cast<size_t>(size) * size, 'D');
+    for (int i = 0; i < size; i++) {
+        for (int j = 0; j < size; j++) {
+            char &cell = level.cells[static_cast<size_t>(i) * size + j];
+            if (i == 0 || j == 0 || i == size - 1 || j == size - 1 || (i % 4 == 2 && j % 4 == 2)) {
+                cell = 'W';
+            } else if (i % 10 == 5 && j % 10 == 5) {
+                cell = 'E';
+            }
+        }
+    }
+    level.cells[static_cast<size_t>(size) + 1] = 'S';
+    level.cells[static_cast<size_t>(size) * 3 + 3] = 'N';
+    return level;
+}
+
+#endif // BENCHLEVEL_H
@@ -0,0 +1,182 @@
+#ifndef BUILTINLEVELS_H
+#define BUILTINLEVELS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include "maze.h"
+
+// Built-in levels are compiled into tables, and the static_asserts below check them, so a
+// malformed built-in layout fails the build instead of misbehaving at runtime. GameState builds
+// the maze, pellet counts and spawns of a built-in level straight from its table, with no parsing
+// and no exit recomputation.
+
+template <int Width, int Height>
+struct LevelTable {
+    static const int width = Width;
+    static const int height = Height;
+    static const int cellCount = Width * Height;
+
+    char cells[cellCount]; // Row-major, in the level cell vocabulary
+    MazeItem items[cellCount]; // The same cells as the maze stores them
+    uint8_t exits[cellCount]; // ExitBits per cell, as Maze computes them
+    int dots;
+    int powerPellets;
+    int pacmanSpawns; // Number of 'S' cells
+    int pacmanSpawn; // Cell index of the last 'S', -1 if none
+    int enemySpawns[cellCount]; // Cell indices of the 'E' cells, in row-major order
+    int enemySpawnCount;
+    bool wellFormed; // Exactly Height rows of Width known cell characters
+};
+
+namespace builtin {
+
+constexpr bool isKnownCell(char cell) {
+    return cell == 'W' || cell == 'D' || cell == 'N' || cell == 'S' || cell == 'E' || cell == 'P';
+}
+
+// One row per line, each ended by '\n', as in the level files
+template <int Width, int Height, size_t Length>
+constexpr LevelTable<Width, Height> compileLevel(const char (&text)[Length]) {
+    LevelTable<Width, Height> table{};
+    table.pacmanSpawn = -1;
+    table.wellFormed = true;
+    int row = 0;
+    int col = 0;
+    for (size_t i = 0; i + 1 < Length; i++) {
+        const char c = text[i];
+        if (c == '\n') {
+            table.wellFormed = table.wellFormed && col == Width;
+            row++;
+            col = 0;
+            continue;
+        }
+        if (row >= Height || col >= Width || !isKnownCell(c)) {
+            table.wellFormed = false;
+            return table;
+        }
+        const int cell = row * Width + col++;
+        table.cells[cell] = c;
+        table.items[cell] = c == 'W' ? MazeItem::Wall : c == 'D' ? MazeItem::Dot
+            : c == 'N' ? MazeItem::PowerPellet : MazeItem::Path;
+        if (c == 'D') {
+            table.dots++;
+        } else if (c == 'N') {
+            table.powerPellets++;
+        } else if (c == 'S') {
+            table.pacmanSpawns++;
+            table.pacmanSpawn = cell;
+        } else if (c == 'E') {
+            table.enemySpawns[table.enemySpawnCount++] = cell;
+        }
+    }
+    table.wellFormed = table.wellFormed && row == Height && col == 0;
+
+    for (int cell = 0; cell < Width * Height; cell++) {
+        const int r = cell / Width;
+        const int c = cell % Width;
+        uint8_t bits = 0;
+        bits |= c + 1 < Width && table.cells[cell + 1] != 'W' ? ExitRight : 0;
+        bits |= c > 0 && table.cells[cell - 1] != 'W' ? ExitLeft : 0;
+        bits |= r + 1 < Height && table.cells[cell + Width] != 'W' ? ExitDown : 0;
+        bits |= r > 0 && table.cells[cell - Width] != 'W' ? ExitUp : 0;
+        table.exits[cell] = bits;
+    }
+    return table;
+}
+
+template <int Width, int Height>
+constexpr bool hasWallBorder(const LevelTable<Width, Height> &table) {
+    for (int col = 0; col < Width; col++) {
+        if (table.cells[col] != 'W' || table.cells[(Height - 1) * Width + col] != 'W')
+            return false;
+    }
+    for (int row = 0; row < Height; row++) {
+        if (table.cells[row * Width] != 'W' || table.cells[row * Width + Width - 1] != 'W')
+            return false;
+    }
+    return true;
+}
+
+// Dots, power pellets and enemy spawns that cannot be walked to from the Pacman spawn
+template <int Width, int Height>
+constexpr int unreachableTargets(const LevelTable<Width, Height> &table) {
+    bool seen[Width * Height] = {};
+    int queue[Width * Height] = {};
+    int tail = 0;
+    if (table.pacmanSpawn >= 0) {
+        seen[table.pacmanSpawn] = true;
+        queue[tail++] = table.pacmanSpawn;
+    }
+    for (int head = 0; head < tail; head++) {
+        const int cell = queue[head];
+        const uint8_t exits = table.exits[cell];
+        const int neighbors[4] = {exits & ExitRight ? cell + 1 : -1, exits & ExitLeft ? cell - 1 : -1,
+                                  exits & ExitDown ? cell + Width : -1, exits & ExitUp ? cell - Width : -1};
+        for (int next : neighbors) {
+            if (next >= 0 && !seen[next]) {
+                seen[next] = true;
+                queue[tail++] = next;
+            }
+        }
+    }
+
+    int unreachable = 0;
+    for (int cell = 0; cell < Width * Height; cell++) {
+        const char c = table.cells[cell];
+        unreachable += !seen[cell] && (c == 'D' || c == 'N' || c == 'E');
+    }
+    return unreachable;
+}
+
+// Is 'level' this table's layout?
+template <int Width, int Height>
+bool isLevel(const LevelTable<Width, Height> &table, const Level &level) {
+    return level.width == Width && level.height == Height && level.cells.size() == static_cast<size_t>(Width * Height)
+        && std::equal(level.cells.begin(), level.cells.end(), table.cells);
+}
+
+template <int Width, int Height>
+Level toLevel(const LevelTable<Width, Height> &table) {
+    Level level;
+    level.width = Width;
+    level.height = Height;
+    level.cells.assign(table.cells, table.cells + Width * Height);
+    return level;
+}
+
+// The classic 20x20 maze, also shipped as levels/classic.txt
+constexpr char classicText[] =
+    "WWWWWWWWWWWWWWWWWWWW\n"
+    "WSDNDDDNDDDDDDDDDDDW\n"
+    "WDWWWDWWWDWWWDWWWDDW\n"
+    "WDWDDDWDDDDNWDDDWDWW\n"
+    "WDWNWWWDWDWDWWWDWDWW\n"
+    "WDDDDDDDWDWDDDWDDDWW\n"
+    "WWWDWDWWWWWWWDWWDWWW\n"
+    "WDDDWDDDDDDDDDDDDDDW\n"
+    "WDWWWDWWWWWWWDWWWDWW\n"
+    "WDWDDEWDEEDDWDDDWDWW\n"
+    "WDDDWWWDWWWDWWWDWDWW\n"
+    "WDDDWDDDDDDDDDDDDDWW\n"
+    "WWWWWWWWWWWWWWWWWDWW\n"
+    "WDDDDDDDDDDDDDDDDDDW\n"
+    "WDWWWDWWWWWWWDWWWEDW\n"
+    "WNWDDDWDDDDDDDDDWNWW\n"
+    "WDWDWWWDWDWDWWWDWDWW\n"
+    "WDDDWDDDWDWDDDWDDDWW\n"
+    "WDWWWWWWWWWWWWWWWDDW\n"
+    "WWWWWWWWWWWWWWWWWWWW\n";
+
+constexpr LevelTable<20, 20> classic = compileLevel<20, 20>(classicText);
+
+static_assert(classic.wellFormed, "classic level: rows must be 20 known cell characters, 20 rows");
+static_assert(hasWallBorder(classic), "classic level: the border must be walls");
+static_assert(classic.pacmanSpawns == 1, "classic level: needs exactly one 'S'");
+static_assert(classic.enemySpawnCount > 0, "classic level: needs at least one 'E'");
+static_assert(classic.dots + classic.powerPellets > 0, "classic level: needs pellets to eat");
+static_assert(unreachableTargets(classic) == 0, "classic level: every pellet and enemy spawn must be reachable");
+
+} // namespace builtin
+
+#endif // BUILTINLEVELS_H
@@ -0,0 +1,88 @@
+#include "flowfield.h"
+
+void FlowField::compute(const MazeView &maze, int targetRow, int targetCol) {
+    compute(maze, targetRow, targetCol, CellBox{0, 0, maze.height - 1, maze.width - 1});
+}
+
+void FlowField::compute(const MazeView &maze, int targetRow, int targetCol, const CellBox &area) {
+    const size_t cellCount = static_cast<size_t>(maze.width) * maze.height;
+    if (maze.width != width || maze.height != height || dist.size() != cellCount) {
+        width = maze.width;
+        height = maze.height;
+        dist.assign(cellCount, unreachable);
+        towardBits.assign(cellCount, 0);
+        queue.resize(cellCount);
+    } else {
+        for (size_t i = 0; i < reached; i++) {
+            dist[queue[i]] = unreachable;
+            towardBits[queue[i]] = 0;
+        }
+    }
+    reached = 0;
+    bounds = area;
+
+    targetCell = targetRow * width + targetCol;
+    if (!maze.contains(targetRow, targetCol) || !area.contains(targetRow, targetCol))
+        return;
+
+    size_t head = 0;
+    size_t tail = 0;
+    dist[targetCell] = 0;
+    queue[tail++] = targetCell;
+
+    while (head < tail) {
+        int cell = queue[head++];
+        int row = cell / width;
+        int col = cell % width;
+        uint8_t exits = maze.exits(row, col);
+        int nextDistance = dist[cell] + 1;
+
+        // A neighbor reached through our right exit gets back here through its left exit, and so on
+        if ((exits & ExitRight) && col < area.lastCol && dist[cell + 1] == unreachable) {
+            dist[cell + 1] = nextDistance;
+            towardBits[cell + 1] = ExitLeft;
+            queue[tail++] = cell + 1;
+        }
+        if ((exits & ExitLeft) && col > area.firstCol && dist[cell - 1] == unreachable) {
+            dist[cell - 1] = nextDistance;
+            towardBits[cell - 1] = ExitRight;
+            queue[tail++] = cell - 1;
+        }
+        if ((exits & ExitDown) && row < area.lastRow && dist[cell + width] == unreachable) {
+            dist[cell + width] = nextDistance;
+            towardBits[cell + width] = ExitUp;
+            queue[tail++] = cell + width;
+        }
+        if ((exits & ExitUp) && row > area.firstRow && dist[cell - width] == unreachable) {
+            dist[cell - width] = nextDistance;
+            towardBits[cell - width] = ExitDown;
+            queue[tail++] = cell - width;
+        }
+    }
+    reached = tail;
+}
+
+uint8_t FlowField::awayFrom(const MazeView &maze, int row, int col) const {
+    uint8_t exits = maze.exits(row, col);
+    int cell = row * width + col;
+    int best = unreachable;
+    uint8_t bestBit = 0;
+
+    if ((exits & ExitRight) && dist[cell + 1] > best) {
+        best = dist[cell + 1];
+        bestBit = ExitRight;
+    }
+    if ((exits & ExitLeft) && dist[cell - 1] > best) {
+        best = dist[cell - 1];
+        bestBit = ExitLeft;
+    }
+    if ((exits & ExitDown) && dist[cell + width] > best) {
+        best = dist[cell + width];
+        bestBit = ExitDown;
+    }
+    if ((exits & ExitUp) && dist[cell - width] > best) {
+        best = dist[cell - width];
+        bestBit = ExitUp;
+    }
+    return bestBit;
+}
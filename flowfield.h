@@ -0,0 +1,46 @@
+#ifndef FLOWFIELD_H
+#define FLOWFIELD_H
+
+#include <cstdint>
+#include <vector>
+#include "maze.h"
+
+// Inclusive block of cells
+struct CellBox {
+    int firstRow, firstCol, lastRow, lastCol;
+
+    bool contains(int row, int col) const { return row >= firstRow && row <= lastRow && col >= firstCol && col <= lastCol; }
+    bool operator==(const CellBox &other) const {
+        return firstRow == other.firstRow && firstCol == other.firstCol && lastRow == other.lastRow && lastCol == other.lastCol;
+    }
+};
+
+// BFS distance field towards one target cell, computed once and shared by every ghost.
+// Each cell also stores the exit bit that leads one step closer, so steering is one byte lookup.
+class FlowField {
+public:
+    static constexpr int unreachable = -1;
+
+    void compute(const MazeView &maze, int targetRow, int targetCol);
+    // Only walks cells inside 'area'; the rest stay unreachable. Clearing the previous result
+    // touches only the cells it reached, so a small area costs the same on any maze size
+    void compute(const MazeView &maze, int targetRow, int targetCol, const CellBox &area);
+    int target() const { return targetCell; } // Row-major index of the target, -1 before the first compute
+    const CellBox &area() const { return bounds; }
+
+    int distance(int row, int col) const { return dist[static_cast<size_t>(row) * width + col]; }
+    uint8_t toward(int row, int col) const { return towardBits[static_cast<size_t>(row) * width + col]; }
+    uint8_t awayFrom(const MazeView &maze, int row, int col) const; // Exit to the neighbor farthest from the target
+
+private:
+    int width = 0;
+    int height = 0;
+    int targetCell = -1;
+    std::vector<int> dist;
+    std::vector<uint8_t> towardBits; // ExitBits towards the target, 0 at the target or when unreachable
+    CellBox bounds = {0, 0, -1, -1};
+    std::vector<int> queue; // Reused between computes to avoid allocating; holds the cells the last compute reached
+    size_t reached = 0;
+};
+
+#endif // FLOWFIELD_H
@@ -0,0 +1,148 @@
+#include "framewriter.h"
+#include <QDir>
+#include <QFile>
+#include <algorithm>
+
+FrameWriter::~FrameWriter() {
+    close();
+}
+
+bool FrameWriter::open(const QString &target, Format format, int threadCount, QString *error) {
+    close();
+    this->format = format;
+    firstError.clear();
+    closing = false;
+    nextIndex = 0;
+    stallCount = 0;
+
+    if (format == Format::Png) {
+        if (!QDir().mkpath(target)) {
+            if (error)
+                *error = "cannot create " + target;
+            return false;
+        }
+        directory = target;
+        if (threadCount <= 0)
+            threadCount = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    } else {
+        ownsVideo = target != "-";
+        video = ownsVideo ? std::fopen(QFile::encodeName(target).constData(), "wb") : stdout;
+        if (!video) {
+            if (error)
+                *error = "cannot open " + target;
+            return false;
+        }
+        threadCount = 1; // Frames of a stream must stay in order
+    }
+
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back(&FrameWriter::run, this);
+    }
+    return true;
+}
+
+void FrameWriter::push(const QImage &frame) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (static_cast<int>(queue.size()) >= defaultQueueDepth) {
+        stallCount++;
+        spaceFree.wait(lock, [this] { return static_cast<int>(queue.size()) < defaultQueueDepth; });
+    }
+    queue.push_back(Frame{nextIndex++, frame}); // Implicitly shared: no pixel copy here
+    frameReady.notify_one();
+}
+
+bool FrameWriter::close(QString *error) {
+    if (threads.empty() && !video)
+        return firstError.isEmpty();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    frameReady.notify_all();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+
+    if (video) {
+        if (std::fflush(video) != 0 && firstError.isEmpty())
+            firstError = "cannot write video";
+        if (ownsVideo)
+            std::fclose(video);
+        video = nullptr;
+    }
+    if (!firstError.isEmpty() && error)
+        *error = firstError;
+    return firstError.isEmpty();
+}
+
+void FrameWriter::run() {
+    for (;;) {
+        Frame frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            frameReady.wait(lock, [this] { return !queue.empty() || closing; });
+            if (queue.empty())
+                return; // Closing and drained
+            frame = std::move(queue.front());
+            queue.pop_front();
+        }
+        spaceFree.notify_one();
+
+        QString error;
+        if (!encode(frame, error)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (firstError.isEmpty())
+                firstError = error;
+        }
+    }
+}
+
+bool FrameWriter::encode(const Frame &frame, QString &error) {
+    if (format == Format::Png) {
+        QString path = QDir(directory).filePath(QString("frame_%1.png").arg(frame.index, 6, 10, QChar('0')));
+        if (!frame.image.save(path, "PNG")) {
+            error = "cannot write " + path;
+            return false;
+        }
+        return true;
+    }
+    if (!writeYuv(frame.image)) {
+        error = "cannot write video frame " + QString::number(frame.index);
+        return false;
+    }
+    return true;
+}
+
+bool FrameWriter::writeYuv(const QImage &source) {
+    // BT.601 studio range, chroma averaged over each 2x2 block
+    QImage image = source.format() == QImage::Format_RGB32 ? source : source.convertToFormat(QImage::Format_RGB32);
+    const int width = image.width(), height = image.height();
+    const int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+    std::vector<uint8_t> planes(static_cast<size_t>(width) * height + 2 * static_cast<size_t>(chromaWidth) * chromaHeight);
+    uint8_t *luma = planes.data();
+    uint8_t *u = luma + static_cast<size_t>(width) * height;
+    uint8_t *v = u + static_cast<size_t>(chromaWidth) * chromaHeight;
+
+    for (int y = 0; y < height; y++) {
+        const QRgb *row = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+        for (int x = 0; x < width; x++) {
+            int r = qRed(row[x]), g = qGreen(row[x]), b = qBlue(row[x]);
+            luma[static_cast<size_t>(y) * width + x] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        }
+    }
+    for (int cy = 0; cy < chromaHeight; cy++) {
+        const QRgb *top = reinterpret_cast<const QRgb *>(image.constScanLine(2 * cy));
+        const QRgb *bottom = reinterpret_cast<const QRgb *>(image.constScanLine(std::min(2 * cy + 1, height - 1)));
+        for (int cx = 0; cx < chromaWidth; cx++) {
+            int x0 = 2 * cx, x1 = std::min(2 * cx + 1, width - 1);
+            int r = (qRed(top[x0]) + qRed(top[x1]) + qRed(bottom[x0]) + qRed(bottom[x1]) + 2) / 4;
+            int g = (qGreen(top[x0]) + qGreen(top[x1]) + qGreen(bottom[x0]) + qGreen(bottom[x1]) + 2) / 4;
+            int b = (qBlue(top[x0]) + qBlue(top[x1]) + qBlue(bottom[x0]) + qBlue(bottom[x1]) + 2) / 4;
+            size_t at = static_cast<size_t>(cy) * chromaWidth + cx;
+            u[at] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            v[at] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+    return std::fwrite(planes.data(), 1, planes.size(), video) == planes.size();
+}
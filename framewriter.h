@@ -0,0 +1,64 @@
+#ifndef FRAMEWRITER_H
+#define FRAMEWRITER_H
+
+#include <QImage>
+#include <QString>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Encodes rendered frames on background threads so the renderer does not wait for them.
+// PNG frames are independent files and are spread over several threads; raw video is
+// written in order by one thread, as planar YUV 4:2:0 (I420) that ffmpeg reads with
+// -f rawvideo -pix_fmt yuv420p
+class FrameWriter {
+public:
+    enum class Format {
+        Png, // directory/frame_000000.png, ...
+        Yuv // One file or "-" for stdout, frames back to back
+    };
+
+    static const int defaultQueueDepth = 32; // Frames rendered ahead of the encoders at most
+
+    FrameWriter() = default;
+    ~FrameWriter();
+
+    FrameWriter(const FrameWriter &) = delete;
+    FrameWriter &operator=(const FrameWriter &) = delete;
+
+    bool open(const QString &target, Format format, int threads = 0, QString *error = nullptr); // 0 threads = all cores
+    void push(const QImage &frame); // Blocks only while defaultQueueDepth frames are already waiting
+    bool close(QString *error = nullptr); // Encodes what is queued, then stops the threads
+
+    int framesWritten() const { return nextIndex; }
+    int stalls() const { return stallCount; } // Pushes that had to wait for an encoder
+
+private:
+    struct Frame {
+        int index;
+        QImage image;
+    };
+
+    Format format = Format::Png;
+    QString directory;
+    FILE *video = nullptr;
+    bool ownsVideo = false; // False when writing to stdout
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable frameReady; // Signals encoders that a frame arrived or the writer is closing
+    std::condition_variable spaceFree; // Signals push() that an encoder took a frame
+    std::deque<Frame> queue;
+    bool closing = false;
+    QString firstError; // Kept until close()
+    int nextIndex = 0;
+    int stallCount = 0;
+
+    void run();
+    bool encode(const Frame &frame, QString &error);
+    bool writeYuv(const QImage &image);
+};
+
+#endif // FRAMEWRITER_H
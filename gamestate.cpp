@@ -0,0 +1,783 @@
+#include "gamestate.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include "builtinlevels.h"
+
+namespace {
+
+int floorDiv(int a, int b) {
+    int q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+// Exit bit for a one-axis direction, 0 for anything else
+uint8_t exitBit(int dx, int dy) {
+    if (dy == 0)
+        return dx > 0 ? ExitRight : (dx < 0 ? ExitLeft : 0);
+    if (dx == 0)
+        return dy > 0 ? ExitDown : ExitUp;
+    return 0;
+}
+
+} // namespace
+
+uint64_t Rng::next() {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+int Rng::bounded(int n) {
+    return static_cast<int>(((next() >> 32) * static_cast<uint64_t>(n)) >> 32);
+}
+
+bool checkWallCollision(int x, int y, int width, int height, const MazeView &maze, int cellSize) {
+    // Right/bottom edges are exclusive, so a box ending exactly on a cell border stays out of the next cell
+    int startX = std::max(0, floorDiv(x, cellSize));
+    int endX = std::min(maze.width - 1, floorDiv(x + width - 1, cellSize));
+    int startY = std::max(0, floorDiv(y, cellSize));
+    int endY = std::min(maze.height - 1, floorDiv(y + height - 1, cellSize));
+
+    for (int i = startY; i <= endY; ++i) {
+        for (int j = startX; j <= endX; ++j) {
+            if (maze.at(i, j) == MazeItem::Wall) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void PacmanState::setDirection(Input input) {
+    switch (input) {
+    case Input::Up:
+        nextDx = 0;
+        nextDy = -1;
+        break;
+    case Input::Down:
+        nextDx = 0;
+        nextDy = 1;
+        break;
+    case Input::Left:
+        nextDx = -1;
+        nextDy = 0;
+        break;
+    case Input::Right:
+        nextDx = 1;
+        nextDy = 0;
+        break;
+    default:
+        break;
+    }
+}
+
+bool PacmanState::isBlocked(int stepX, int stepY, const MazeView &maze, int cellSize) const {
+    // From a cell center, a step of at most one cell along one axis only reaches the neighbor,
+    // so the precomputed exit mask answers it
+    uint8_t bit = exitBit(stepX, stepY);
+    int row = y / cellSize;
+    int col = x / cellSize;
+    if (bit != 0 && std::abs(stepX + stepY) <= cellSize && x % cellSize == cellSize / 2
+        && y % cellSize == cellSize / 2 && maze.contains(row, col)) {
+        return !(maze.exits(row, col) & bit);
+    }
+    return checkWallCollision(x + stepX - cellSize / 2, y + stepY - cellSize / 2, cellSize, cellSize, maze, cellSize);
+}
+
+void PacmanState::move(const MazeView &maze, int cellSize) {
+    bool canMoveInNextDirection = !isBlocked(nextDx * speed, nextDy * speed, maze, cellSize);
+
+    if (canMoveInNextDirection) {
+        dx = nextDx;
+        dy = nextDy;
+        x += nextDx * speed;
+        y += nextDy * speed;
+    } else {
+        bool canMoveInCurrentDirection = !isBlocked(dx * speed, dy * speed, maze, cellSize);
+
+        if (canMoveInCurrentDirection) {
+            if (dx != nextDx || dy != nextDy) {
+                x += dx * speed;
+                y += dy * speed;
+            } else {
+                dx = 0;
+                dy = 0;
+            }
+        } else {
+            dx = 0;
+            dy = 0;
+        }
+    }
+}
+
+GameState::GameState(uint64_t initialSeed)
+    : GameState(defaultLevel(), initialSeed)
+{
+}
+
+void EnemyPool::resize(int count) {
+    x.resize(count);
+    y.resize(count);
+    dx.resize(count);
+    dy.resize(count);
+    state.resize(count, GhostState::Scatter);
+    waypoint.resize(count);
+}
+
+GameState::GameState(const Level &startLevel, uint64_t initialSeed, int enemyCount)
+    : remainingDots(0), remainingPowerPellets(0), score(0), lives(startLives), gameEnded(false), won(false),
+    powerUpActive(false), powerUpRemaining(0), tick(0),
+    eatenRow(-1), eatenCol(-1), caughtBy(-1), events(0), seed(initialSeed), rng(initialSeed), ghostPolicy(GhostPolicy::Random),
+    ghostSeparation(false), activeRadius(0), scatterMode(true), modeRemaining(0), profiler(nullptr),
+    tickRate(defaultTickRate), level(startLevel), levelId(0),
+    startDots(0), startPowerPellets(0), enemyGridValid(false), ghostGroupStart(), ghostGroupsValid(false)
+{
+    enemies.resize(enemyCount);
+    initializeMaze();
+    reset();
+}
+
+void GameState::loadLevel(const Level &newLevel) {
+    level = newLevel;
+    initializeMaze();
+    reset();
+}
+
+void GameState::setTickRate(int ticksPerSecond) {
+    if (ticksPerSecond <= 0) {
+        tickRate = defaultTickRate;
+    } else {
+        tickRate = ticksPerSecond < maxTickRate ? ticksPerSecond : maxTickRate;
+    }
+}
+
+void GameState::setEnemyCount(int count) {
+    enemies.resize(count);
+    reset();
+}
+
+void GameState::reset() {
+    rng.seed(seed);
+    lives = startLives;
+    score = 0;
+    gameEnded = false;
+    won = false;
+    tick = 0;
+    eatenRow = -1;
+    eatenCol = -1;
+    caughtBy = -1;
+    events = 0;
+    scatterMode = true;
+    modeRemaining = secondsToTicks(scatterSeconds);
+    endPowerUp();
+    maze = startMaze;
+    remainingDots = startDots;
+    remainingPowerPellets = startPowerPellets;
+    resetPositions();
+}
+
+GameSnapshot GameState::snapshot() const {
+    GameSnapshot snapshot;
+    snapshot.maze = maze;
+    snapshot.remainingDots = remainingDots;
+    snapshot.remainingPowerPellets = remainingPowerPellets;
+    snapshot.pacman = pacman;
+    snapshot.enemies = enemies;
+    snapshot.score = score;
+    snapshot.lives = lives;
+    snapshot.gameEnded = gameEnded;
+    snapshot.won = won;
+    snapshot.powerUpActive = powerUpActive;
+    snapshot.powerUpRemaining = powerUpRemaining;
+    snapshot.tick = tick;
+    snapshot.eatenRow = eatenRow;
+    snapshot.eatenCol = eatenCol;
+    snapshot.caughtBy = caughtBy;
+    snapshot.events = events;
+    snapshot.rng = rng;
+    snapshot.scatterMode = scatterMode;
+    snapshot.modeRemaining = modeRemaining;
+    return snapshot;
+}
+
+void GameState::restore(const GameSnapshot &snapshot) {
+    maze.restore(snapshot.maze); // Tiles this game copied since are kept for its next writes
+    remainingDots = snapshot.remainingDots;
+    remainingPowerPellets = snapshot.remainingPowerPellets;
+    pacman = snapshot.pacman;
+    enemies = snapshot.enemies; // Vector assignment reuses the existing capacity
+    score = snapshot.score;
+    lives = snapshot.lives;
+    gameEnded = snapshot.gameEnded;
+    won = snapshot.won;
+    powerUpActive = snapshot.powerUpActive;
+    powerUpRemaining = snapshot.powerUpRemaining;
+    tick = snapshot.tick;
+    eatenRow = snapshot.eatenRow;
+    eatenCol = snapshot.eatenCol;
+    caughtBy = snapshot.caughtBy;
+    events = snapshot.events;
+    rng = snapshot.rng;
+    scatterMode = snapshot.scatterMode;
+    modeRemaining = snapshot.modeRemaining;
+    enemyGridValid = false;
+    ghostGroupsValid = false;
+}
+
+void GameState::resetPositions() {
+    enemyGridValid = false;
+    // Reset Pacman
+    pacman.x = pacmanSpawn.x;
+    pacman.y = pacmanSpawn.y;
+    pacman.setDirection(Input::Right);
+
+    // Reset enemies to their initial positions
+    const int spawnCount = static_cast<int>(enemySpawns.size());
+    for (int i = 0; i < enemies.size(); i++) {
+        Point spawn = enemySpawns[i % spawnCount];
+        enemies.x[i] = spawn.x;
+        enemies.y[i] = spawn.y;
+        enemies.dx[i] = (i % 2 == 0) ? cellSize : -cellSize;
+        enemies.dy[i] = 0;
+        enemies.waypoint[i] = static_cast<uint8_t>(i % 4);
+        changeEnemyDirection(i);
+    }
+}
+
+void GameState::initializeMaze() {
+    static std::atomic<uint64_t> nextLevelId(1);
+    levelId = nextLevelId++;
+    enemySpawns.clear();
+    bool hasPacmanSpawn = false;
+
+    if (builtin::isLevel(builtin::classic, level)) {
+        // Everything was worked out and checked at compile time
+        const auto &table = builtin::classic;
+        maze = Maze(table.width, table.height, table.items, table.exits);
+        remainingDots = table.dots;
+        remainingPowerPellets = table.powerPellets;
+        pacmanSpawn = getCellCenter(table.pacmanSpawn / table.width, table.pacmanSpawn % table.width);
+        hasPacmanSpawn = true;
+        for (int i = 0; i < table.enemySpawnCount; i++) {
+            enemySpawns.push_back(getCellCenter(table.enemySpawns[i] / table.width, table.enemySpawns[i] % table.width));
+        }
+    } else {
+        maze = Maze(level.width, level.height);
+        remainingDots = 0;
+        remainingPowerPellets = 0;
+        for (int i = 0; i < level.height; ++i) {
+            for (int j = 0; j < level.width; ++j) {
+                switch (level.at(i, j)) {
+                case 'W':
+                    maze.set(i, j, MazeItem::Wall);
+                    break;
+                case 'D':
+                    maze.set(i, j, MazeItem::Dot);
+                    remainingDots++;
+                    break;
+                case 'P':
+                    maze.set(i, j, MazeItem::Path);
+                    break;
+                case 'N':
+                    maze.set(i, j, MazeItem::PowerPellet);
+                    remainingPowerPellets++;
+                    break;
+                case 'S':
+                    maze.set(i, j, MazeItem::Path);
+                    pacmanSpawn = getCellCenter(i, j);
+                    hasPacmanSpawn = true;
+                    break;
+                case 'E':
+                    maze.set(i, j, MazeItem::Path);
+                    enemySpawns.push_back(getCellCenter(i, j));
+                    break;
+                default:
+                    maze.set(i, j, MazeItem::Path);
+                    break;
+                }
+            }
+        }
+    }
+
+    // Levels without 'S' or 'E' cells spawn on the open cell closest to the middle of the maze
+    if (!hasPacmanSpawn || enemySpawns.empty()) {
+        Point middle = nearestOpenCell(level.height / 2, level.width / 2);
+        if (!hasPacmanSpawn)
+            pacmanSpawn = getCellCenter(middle.y, middle.x);
+        if (enemySpawns.empty())
+            enemySpawns.push_back(getCellCenter(middle.y, middle.x));
+    }
+
+    // Walls never change during a game, so the corner fields are built once here. A corner
+    // within scatterClearance steps of Pacman's spawn would send its ghosts onto him at the start
+    // of every life, so it is swapped for the corner farthest from the spawn
+    const Point corners[4] = {{0, 0}, {level.width - 1, 0}, {0, level.height - 1}, {level.width - 1, level.height - 1}};
+    FlowField fromSpawn;
+    fromSpawn.compute(maze.view(), pacmanSpawn.y / cellSize, pacmanSpawn.x / cellSize);
+    Point targets[4];
+    int farthest = 0;
+    for (int c = 0; c < 4; c++) {
+        targets[c] = nearestOpenCell(corners[c].y, corners[c].x);
+        if (fromSpawn.distance(targets[c].y, targets[c].x) > fromSpawn.distance(targets[farthest].y, targets[farthest].x))
+            farthest = c;
+    }
+    for (int c = 0; c < 4; c++) {
+        const int distance = fromSpawn.distance(targets[c].y, targets[c].x);
+        Point target = distance != FlowField::unreachable && distance < scatterClearance ? targets[farthest] : targets[c];
+        scatterFields[c].compute(maze.view(), target.y, target.x);
+    }
+    chaseField = FlowField();
+
+    startMaze = maze;
+    startDots = remainingDots;
+    startPowerPellets = remainingPowerPellets;
+}
+
+CellBox GameState::activeArea() const {
+    if (activeRadius <= 0)
+        return CellBox{0, 0, maze.height() - 1, maze.width() - 1};
+    int tileRow = std::max(0, pacman.y / cellSize) >> mazeTileShift;
+    int tileCol = std::max(0, pacman.x / cellSize) >> mazeTileShift;
+    return CellBox{std::max(0, (tileRow - activeRadius) << mazeTileShift),
+                   std::max(0, (tileCol - activeRadius) << mazeTileShift),
+                   std::min(maze.height() - 1, ((tileRow + activeRadius + 1) << mazeTileShift) - 1),
+                   std::min(maze.width() - 1, ((tileCol + activeRadius + 1) << mazeTileShift) - 1)};
+}
+
+Point GameState::nearestOpenCell(int row, int col) const {
+    // Walk outwards in growing diamonds until a non-wall cell shows up
+    int maxRadius = maze.width() + maze.height();
+    for (int radius = 0; radius <= maxRadius; radius++) {
+        for (int dr = -radius; dr <= radius; dr++) {
+            int dc = radius - std::abs(dr);
+            if (maze.contains(row + dr, col - dc) && maze.at(row + dr, col - dc) != MazeItem::Wall)
+                return Point{col - dc, row + dr};
+            if (maze.contains(row + dr, col + dc) && maze.at(row + dr, col + dc) != MazeItem::Wall)
+                return Point{col + dc, row + dr};
+        }
+    }
+    return Point{col, row};
+}
+
+Point GameState::getCellCenter(int row, int col) const {
+    return Point{col * cellSize + cellSize / 2, row * cellSize + cellSize / 2};
+}
+
+void GameState::changeEnemyDirection(int index) {
+    // Enemies always sit on a cell center, so their open neighbors are the cell's exit mask
+    int row = enemies.y[index] / cellSize;
+    int col = enemies.x[index] / cellSize;
+    if (!maze.contains(row, col))
+        return;
+    uint8_t exits = maze.exits(row, col);
+
+    Point possibleDirections[4];
+    int possibleCount = 0;
+    if (exits & ExitRight)
+        possibleDirections[possibleCount++] = Point{cellSize, 0};
+    if (exits & ExitLeft)
+        possibleDirections[possibleCount++] = Point{-cellSize, 0};
+    if (exits & ExitDown)
+        possibleDirections[possibleCount++] = Point{0, cellSize};
+    if (exits & ExitUp)
+        possibleDirections[possibleCount++] = Point{0, -cellSize};
+
+    if (possibleCount > 0) {
+        Point newDirection = possibleDirections[rng.bounded(possibleCount)];
+        enemies.dx[index] = newDirection.x;
+        enemies.dy[index] = newDirection.y;
+    }
+}
+
+void GameState::advanceGhostMode() {
+    if (--modeRemaining <= 0) {
+        scatterMode = !scatterMode;
+        if (scatterMode) {
+            modeRemaining = secondsToTicks(scatterSeconds);
+        } else {
+            modeRemaining = secondsToTicks(chaseSeconds);
+        }
+        // Frightened ghosts keep fleeing; endPowerUp applies the phase they missed
+        if (!powerUpActive)
+            applyGhostEvent(scatterMode ? GhostEvent::ScatterPhase : GhostEvent::ChasePhase);
+    }
+}
+
+void GameState::applyGhostEvent(GhostEvent event) {
+    const int column = static_cast<int>(event);
+    const int count = enemies.size();
+    for (int i = 0; i < count; i++) {
+        enemies.state[i] = ghostPersonality(i).next[column];
+    }
+    ghostGroupsValid = false;
+}
+
+void GameState::groupGhostsByState() {
+    // Counting sort: states change only on events, so this runs a few times per phase, not per tick
+    const int count = enemies.size();
+    int offsets[ghostStateCount + 1] = {};
+    for (int i = 0; i < count; i++) {
+        offsets[static_cast<int>(enemies.state[i]) + 1]++;
+    }
+    for (int s = 0; s < ghostStateCount; s++) {
+        offsets[s + 1] += offsets[s];
+        ghostGroupStart[s] = offsets[s];
+    }
+    ghostGroupStart[ghostStateCount] = count;
+    ghostOrder.resize(count);
+    for (int i = 0; i < count; i++) {
+        ghostOrder[offsets[static_cast<int>(enemies.state[i])]++] = i;
+    }
+    ghostGroupsValid = true;
+}
+
+void GameState::steerEnemies() {
+    advanceGhostMode();
+
+    const MazeView view = maze.view();
+    const CellBox area = activeArea();
+    int pacmanRow = pacman.y / cellSize;
+    int pacmanCol = pacman.x / cellSize;
+    if (maze.contains(pacmanRow, pacmanCol)
+        && (chaseField.target() != pacmanRow * maze.width() + pacmanCol || !(chaseField.area() == area))) {
+        chaseField.compute(view, pacmanRow, pacmanCol, area);
+    }
+
+    // Exit bit -> one-cell step; entries for bit combinations are never used
+    static const int stepX[9] = {0, 1, -1, 0, 0, 0, 0, 0, 0};
+    static const int stepY[9] = {0, 0, 0, 0, 1, 0, 0, 0, -1};
+
+    const int count = enemies.size();
+    for (int i = 0; i < count; i++) {
+        int row = enemies.y[i] / cellSize;
+        int col = enemies.x[i] / cellSize;
+        if (!area.contains(row, col))
+            continue; // Idle outside the active area
+        uint8_t bit;
+        if (powerUpActive) {
+            bit = chaseField.awayFrom(view, row, col);
+        } else if (scatterMode) {
+            bit = scatterFields[i % 4].toward(row, col);
+        } else {
+            bit = chaseField.toward(row, col);
+        }
+        if (bit != 0) {
+            enemies.dx[i] = stepX[bit] * cellSize;
+            enemies.dy[i] = stepY[bit] * cellSize;
+        }
+    }
+}
+
+void GameState::steerPersonalities() {
+    advanceGhostMode();
+    if (!ghostGroupsValid)
+        groupGhostsByState();
+
+    const MazeView view = maze.view();
+    const CellBox area = activeArea();
+    const int *order = ghostOrder.data();
+    auto groupSize = [this](GhostState state) {
+        return ghostGroupStart[static_cast<int>(state) + 1] - ghostGroupStart[static_cast<int>(state)];
+    };
+
+    int pacmanRow = pacman.y / cellSize;
+    int pacmanCol = pacman.x / cellSize;
+    const bool pacmanInside = maze.contains(pacmanRow, pacmanCol);
+    if (pacmanInside && groupSize(GhostState::Chase) + groupSize(GhostState::Flee) > 0
+        && (chaseField.target() != pacmanRow * maze.width() + pacmanCol || !(chaseField.area() == area))) {
+        chaseField.compute(view, pacmanRow, pacmanCol, area);
+    }
+    // Ambushers aim along Pacman's heading, or the turn he asked for while standing still. The
+    // target moves with every cell he walks, so rather than a second flow field they take the
+    // exit closest to it in a straight line, as the arcade ghosts did
+    const int headingX = pacman.dx != 0 || pacman.dy != 0 ? pacman.dx : pacman.nextDx;
+    const int headingY = pacman.dx != 0 || pacman.dy != 0 ? pacman.dy : pacman.nextDy;
+    const int ambushRow = pacmanRow + headingY * ambushLead;
+    const int ambushCol = pacmanCol + headingX * ambushLead;
+
+    // Exit bit -> one-cell step; entries for bit combinations are never used
+    static const int stepX[9] = {0, 1, -1, 0, 0, 0, 0, 0, 0};
+    static const int stepY[9] = {0, 0, 0, 0, 1, 0, 0, 0, -1};
+
+    // One loop per state over that state's enemies, so the per-enemy work is a field lookup
+    auto steerGroup = [&](GhostState state, auto pickExit) {
+        const int end = ghostGroupStart[static_cast<int>(state) + 1];
+        for (int k = ghostGroupStart[static_cast<int>(state)]; k < end; k++) {
+            const int i = order[k];
+            int row = enemies.y[i] / cellSize;
+            int col = enemies.x[i] / cellSize;
+            if (!area.contains(row, col))
+                continue; // Idle outside the active area
+            uint8_t bit = pickExit(i, row, col);
+            if (bit != 0) {
+                enemies.dx[i] = stepX[bit] * cellSize;
+                enemies.dy[i] = stepY[bit] * cellSize;
+            }
+        }
+    };
+    steerGroup(GhostState::Chase, [this](int, int row, int col) { return chaseField.toward(row, col); });
+    steerGroup(GhostState::Ambush, [this, &view, ambushRow, ambushCol](int i, int row, int col) {
+        // Turning back only out of a dead end keeps them from dithering around the target
+        const int heading = (enemies.dx[i] > 0) | (enemies.dx[i] < 0) << 1 | (enemies.dy[i] > 0) << 2
+            | (enemies.dy[i] < 0) << 3;
+        const int reverse = (heading & 5) << 1 | (heading & 10) >> 1;
+        uint8_t exits = view.exits(row, col);
+        if (exits & ~reverse)
+            exits &= ~reverse;
+        uint8_t best = 0;
+        int bestDistance = 0;
+        for (uint8_t bit = ExitRight; bit <= ExitUp; bit <<= 1) {
+            if (!(exits & bit))
+                continue;
+            const int dr = row + stepY[bit] - ambushRow;
+            const int dc = col + stepX[bit] - ambushCol;
+            const int distance = dr * dr + dc * dc;
+            if (best == 0 || distance < bestDistance) {
+                best = bit;
+                bestDistance = distance;
+            }
+        }
+        return best;
+    });
+    steerGroup(GhostState::Patrol, [this](int i, int row, int col) {
+        uint8_t bit = scatterFields[enemies.waypoint[i]].toward(row, col);
+        if (bit == 0) {
+            // Reached this corner (or cannot reach it): go on to the next one
+            enemies.waypoint[i] = (enemies.waypoint[i] + 1) & 3;
+            bit = scatterFields[enemies.waypoint[i]].toward(row, col);
+        }
+        return bit;
+    });
+    steerGroup(GhostState::Scatter, [this](int i, int row, int col) { return scatterFields[i % 4].toward(row, col); });
+    steerGroup(GhostState::Flee, [this, &view](int, int row, int col) { return chaseField.awayFrom(view, row, col); });
+    // Wander keeps its heading; moveEnemies turns it at random when blocked
+}
+
+void GameState::markCrowdedEnemies() {
+    // An enemy holds still and turns when its next cell is taken, or when a lower-numbered enemy
+    // on its own cell is heading the same way, which splits up enemies stacked on one cell.
+    // Enemies move simultaneously, so two of them can still step into the same free cell
+    const int count = enemies.size();
+    if (!enemyGridValid) {
+        enemyGrid.build(enemies.x.data(), enemies.y.data(), count, cellSize, maze.width());
+    }
+    enemyCrowded.resize(count);
+    for (int i = 0; i < count; i++) {
+        int row = enemies.y[i] / cellSize;
+        int col = enemies.x[i] / cellSize;
+        int nextRow = (enemies.y[i] + enemies.dy[i]) / cellSize;
+        int nextCol = (enemies.x[i] + enemies.dx[i]) / cellSize;
+        bool crowded = maze.contains(nextRow, nextCol) && enemyGrid.occupied(nextRow, nextCol, i);
+        if (!crowded) {
+            enemyGrid.forEachInCell(row, col, [this, i, &crowded](int other) {
+                crowded = other < i && enemies.dx[other] == enemies.dx[i] && enemies.dy[other] == enemies.dy[i];
+                return !crowded && other < i;
+            });
+        }
+        enemyCrowded[i] = crowded;
+    }
+}
+
+void GameState::moveEnemies() {
+    if (ghostPolicy == GhostPolicy::ChaseScatter) {
+        steerEnemies();
+    } else if (ghostPolicy == GhostPolicy::Personalities) {
+        steerPersonalities();
+    }
+
+    const int count = enemies.size();
+    const MazeView view = maze.view();
+    int *x = enemies.x.data();
+    int *y = enemies.y.data();
+    const int *dx = enemies.dx.data();
+    const int *dy = enemies.dy.data();
+    enemyScratch.resize(count);
+    int *blocked = enemyScratch.data();
+    const int *crowded = nullptr;
+    if (ghostSeparation) {
+        markCrowdedEnemies();
+        crowded = enemyCrowded.data();
+    }
+
+    const bool limited = activeRadius > 0;
+    const CellBox area = activeArea();
+
+    // Branch-free pass: look up the exit bit for each enemy's heading and step if it is open
+    for (int i = 0; i < count; i++) {
+        int row = y[i] / cellSize;
+        int col = x[i] / cellSize;
+        int bit = (dx[i] > 0) | (dx[i] < 0) << 1 | (dy[i] > 0) << 2 | (dy[i] < 0) << 3;
+        int open = (view.exits(row, col) & bit) != 0;
+        if (crowded)
+            open &= !crowded[i];
+        int active = !limited || area.contains(row, col); // Idle enemies neither move nor turn
+        open &= active;
+        x[i] += dx[i] * open;
+        y[i] += dy[i] * open;
+        blocked[i] = active & !open;
+    }
+
+    // Turning draws from the RNG, so it stays sequential in index order
+    for (int i = 0; i < count; i++) {
+        if (blocked[i]) {
+            changeEnemyDirection(i);
+        }
+    }
+
+    // With separation on, the grid is needed again next tick anyway, so keep it current
+    // and let this tick's collision test use it too
+    enemyGridValid = false;
+    if (ghostSeparation) {
+        enemyGrid.build(x, y, count, cellSize, maze.width());
+        enemyGridValid = true;
+    }
+}
+
+void GameState::step(Input input) {
+    if (isOver())
+        return;
+
+    beginStep();
+    {
+        ScopedTimer timer(profiler, ProfilePhase::PacmanMove);
+        pacman.setDirection(input);
+        pacman.move(maze.view(), cellSize);
+    }
+    {
+        ScopedTimer timer(profiler, ProfilePhase::EnemyMove);
+        moveEnemies();
+    }
+    {
+        ScopedTimer timer(profiler, ProfilePhase::PelletCollision);
+        score += eatPellet(pacman);
+    }
+
+    ScopedTimer timer(profiler, ProfilePhase::EnemyCollision);
+    for (int i : findEnemyHits(pacman)) {
+        if (powerUpActive) {
+            respawnEnemy(i);
+        } else {
+            lives--;
+            caughtBy = i;
+            events |= EventDeath;
+            if (lives <= 0) {
+                gameEnded = true;
+            } else {
+                resetPositions();
+            }
+            break;
+        }
+    }
+
+    if (!gameEnded && remainingDots == 0 && remainingPowerPellets == 0) {
+        won = true;
+    }
+}
+
+void GameState::beginStep() {
+    ++tick;
+    eatenRow = -1;
+    eatenCol = -1;
+    caughtBy = -1;
+    events = 0;
+    if (powerUpActive && --powerUpRemaining <= 0) {
+        endPowerUp();
+    }
+}
+
+void GameState::respawnEnemy(int index) {
+    Point respawn = enemySpawns[index % enemySpawns.size()];
+    enemies.x[index] = respawn.x;
+    enemies.y[index] = respawn.y;
+    enemyGridValid = false;
+    enemies.state[index] = ghostPersonality(index).next[static_cast<int>(GhostEvent::Respawn)];
+    ghostGroupsValid = false;
+    events |= EventGhostEaten;
+    changeEnemyDirection(index);
+}
+
+const std::vector<int> &GameState::findEnemyHits(const PacmanState &target) {
+    // Same test as QRect::intersects between the target's cell-sized box and the 30x30 enemy box
+    const int count = enemies.size();
+    const int reach = cellSize / 2 + 15 - 1;
+    enemyHits.clear();
+
+    if (enemyGridValid) {
+        // Enemies sit on cell centers, so only the few cells within reach of the target can hold a hit
+        const int firstRow = std::max(0, floorDiv(target.y - reach, cellSize));
+        const int lastRow = std::min(maze.height() - 1, floorDiv(target.y + reach, cellSize));
+        const int firstCol = std::max(0, floorDiv(target.x - reach, cellSize));
+        const int lastCol = std::min(maze.width() - 1, floorDiv(target.x + reach, cellSize));
+        for (int row = firstRow; row <= lastRow; row++) {
+            for (int col = firstCol; col <= lastCol; col++) {
+                enemyGrid.forEachInCell(row, col, [this, &target, reach](int i) {
+                    if (std::abs(enemies.x[i] - target.x) <= reach && std::abs(enemies.y[i] - target.y) <= reach)
+                        enemyHits.push_back(i);
+                    return true;
+                });
+            }
+        }
+        // Hits are handled in index order, exactly like the linear scan
+        std::sort(enemyHits.begin(), enemyHits.end());
+        return enemyHits;
+    }
+
+    // Without a current grid, one branch-free pass is cheaper than building one for a single query
+    enemyScratch.resize(count);
+    int *hit = enemyScratch.data();
+    for (int i = 0; i < count; i++) {
+        hit[i] = std::abs(enemies.x[i] - target.x) <= reach && std::abs(enemies.y[i] - target.y) <= reach;
+    }
+    for (int i = 0; i < count; i++) {
+        if (hit[i])
+            enemyHits.push_back(i);
+    }
+    return enemyHits;
+}
+
+int GameState::eatPellet(const PacmanState &eater) {
+    // Only the cell containing the eater's center can be closer than half a cell to its center
+    int row = eater.y / cellSize;
+    int col = eater.x / cellSize;
+    if (eater.x < 0 || eater.y < 0 || !maze.contains(row, col))
+        return 0;
+
+    MazeItem cell = maze.at(row, col);
+    if (cell != MazeItem::Dot && cell != MazeItem::PowerPellet)
+        return 0;
+
+    Point center = getCellCenter(row, col);
+    int ddx = eater.x - center.x;
+    int ddy = eater.y - center.y;
+    if (ddx * ddx + ddy * ddy >= (cellSize / 2) * (cellSize / 2))
+        return 0;
+
+    if (cell == MazeItem::Dot) {
+        remainingDots--;
+        events |= EventDot;
+    } else {
+        remainingPowerPellets--;
+        events |= EventPowerPellet;
+        startPowerUp();
+    }
+    maze.set(row, col, MazeItem::Path);
+    eatenRow = row;
+    eatenCol = col;
+    return cell == MazeItem::Dot ? 10 : 50;
+}
+
+void GameState::startPowerUp() {
+    powerUpActive = true;
+    pacman.speed = pacmanSpeed * 2;
+    powerUpRemaining = secondsToTicks(powerUpSeconds);
+    applyGhostEvent(GhostEvent::PowerUp);
+}
+
+void GameState::endPowerUp() {
+    powerUpActive = false;
+    pacman.speed = pacmanSpeed;
+    powerUpRemaining = 0;
+    applyGhostEvent(scatterMode ? GhostEvent::ScatterPhase : GhostEvent::ChasePhase);
+}
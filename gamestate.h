@@ -0,0 +1,211 @@
+#ifndef GAMESTATE_H
+#define GAMESTATE_H
+
+#include <cstdint>
+#include <vector>
+#include "maze.h"
+#include "flowfield.h"
+#include "ghostbehavior.h"
+#include "profiler.h"
+#include "spatialhash.h"
+
+// Plain C++ game engine: no Qt dependency so it can run headless in batch jobs and tests
+
+// Direction requested by the player for a tick (None keeps the buffered one)
+enum class Input {
+    None,
+    Up,
+    Down,
+    Left,
+    Right
+};
+
+// Small seedable RNG (splitmix64) so runs can be reproduced exactly on any platform
+class Rng {
+public:
+    explicit Rng(uint64_t seed = 1) : state(seed) {}
+    void seed(uint64_t newSeed) { state = newSeed; }
+    uint64_t next();
+    int bounded(int n); // Uniform-ish value in [0, n)
+
+private:
+    uint64_t state;
+};
+
+struct Point {
+    int x = 0;
+    int y = 0;
+};
+
+// Single collision routine for everything that moves: does the rectangle (x, y, width, height) touch a wall cell?
+bool checkWallCollision(int x, int y, int width, int height, const MazeView &maze, int cellSize);
+
+// Movement state of Pacman, shared by the engine and the Pacman widget
+struct PacmanState {
+    int x = 0, y = 0;
+    int dx = 0, dy = 0;
+    int nextDx = 0, nextDy = 0;
+    int speed = 2;
+
+    void setDirection(Input input);
+    void move(const MazeView &maze, int cellSize);
+    bool isBlocked(int stepX, int stepY, const MazeView &maze, int cellSize) const; // Would this step hit a wall?
+};
+
+// What happened during the last step, as bits of GameState::events (for sound and effects)
+enum StepEvent : uint8_t {
+    EventDot = 1,
+    EventPowerPellet = 2,
+    EventGhostEaten = 4,
+    EventDeath = 8
+};
+
+// How enemies pick their direction
+enum class GhostPolicy {
+    Random, // Turn towards a random open neighbor when blocked
+    ChaseScatter, // Follow shared flow fields: chase Pacman, periodically scatter to the corners, flee during power-ups
+    Personalities // Per-ghost state machines from ghostbehavior.h: chase, ambush, patrol, wander, flee
+};
+
+// Enemy pool in struct-of-arrays layout so the per-tick loops stay tight and vectorizable
+struct EnemyPool {
+    std::vector<int> x, y; // Cell-center positions in pixels
+    std::vector<int> dx, dy; // Movement per tick (one cell along one axis)
+    std::vector<GhostState> state; // Current behavior (Personalities policy)
+    std::vector<uint8_t> waypoint; // Corner a patrolling enemy is heading for
+
+    int size() const { return static_cast<int>(x.size()); }
+    void resize(int count);
+};
+
+// Everything that changes during play. The maze shares its tiles with the game it came from,
+// so taking one costs a pointer per maze tile plus the enemy arrays; level, settings and
+// flow fields are not included and must match the game it is restored into
+struct GameSnapshot {
+    Maze maze;
+    int remainingDots = 0;
+    int remainingPowerPellets = 0;
+    PacmanState pacman;
+    EnemyPool enemies;
+    int score = 0;
+    int lives = 0;
+    bool gameEnded = false;
+    bool won = false;
+    bool powerUpActive = false;
+    int powerUpRemaining = 0;
+    uint64_t tick = 0;
+    int eatenRow = -1, eatenCol = -1;
+    int caughtBy = -1;
+    uint8_t events = 0;
+    Rng rng;
+    bool scatterMode = true;
+    int modeRemaining = 0;
+};
+
+class GameState {
+public:
+    static const int cellSize = 20; // Size of each cell in pixels
+    static const int defaultEnemyCount = 3;
+    static const int maxEnemyCount = 1000000; // Most enemies a replay may ask for
+    static const int startLives = 3;
+    static const int pacmanSpeed = 2;
+    static const int defaultTickRate = 10; // Simulation steps per second; movement per step is fixed
+    static const int maxTickRate = 1000; // Ticks must stay at least a millisecond long
+    static const int powerUpSeconds = 10; // Power-up duration
+    static const int scatterSeconds = 7; // Ghosts head for their corners for 7 s...
+    static const int chaseSeconds = 20; // ...then chase Pacman for 20 s
+    static const int scatterClearance = 8; // Scatter corners are at least this many steps from Pacman's spawn
+
+    explicit GameState(uint64_t initialSeed = 1);
+    GameState(const Level &startLevel, uint64_t initialSeed, int enemyCount = defaultEnemyCount);
+
+    void loadLevel(const Level &newLevel); // Switch to another layout and restart
+    void setEnemyCount(int count); // Resize the enemy pool and restart
+    int enemyCount() const { return enemies.size(); }
+    void setTickRate(int ticksPerSecond); // Timed effects are counted in steps at this rate; capped at maxTickRate
+    int getTickRate() const { return tickRate; }
+    const Level &getLevel() const { return level; }
+    uint64_t getLevelId() const { return levelId; } // New for every level loaded; copies of a game keep it
+    int secondsToTicks(int seconds) const { return seconds * tickRate; }
+
+    void reset(); // Restart the game: fresh maze, score and lives, RNG reseeded from 'seed'
+    GameSnapshot snapshot() const;
+    void restore(const GameSnapshot &snapshot); // Rewind to a snapshot taken from this game (same level)
+    void resetPositions(); // Put Pacman and enemies back on their spawn cells
+    void step(Input input); // Advance the simulation by one tick
+
+    // The rule pieces step() is made of, in its order, for drivers that move several Pacmans in one
+    // world (Arena). Pellets and power-ups are shared; enemies chase 'pacman'
+    void beginStep(); // Count the tick, clear the per-step results and run down the power-up
+    void moveEnemies(); // Advance every enemy one cell, turning the blocked ones
+    int eatPellet(const PacmanState &eater); // Consume whatever is in the eater's cell, returns the points
+    // Enemies touching 'target', in index order; valid until the next call
+    const std::vector<int> &findEnemyHits(const PacmanState &target);
+    void respawnEnemy(int index); // An eaten enemy restarts from its spawn cell
+    Point getPacmanSpawn() const { return pacmanSpawn; }
+
+    bool isOver() const { return gameEnded || won; }
+    Point getCellCenter(int row, int col) const; // Helper to get the center of a cell
+
+    Maze maze; // Current maze contents, pellets are cleared as they are eaten
+    int remainingDots; // Dots still in the maze
+    int remainingPowerPellets; // Power pellets still in the maze
+    PacmanState pacman;
+    EnemyPool enemies;
+    int score;
+    int lives;
+    bool gameEnded; // Pacman ran out of lives
+    bool won; // Every pellet was eaten
+    bool powerUpActive;
+    int powerUpRemaining; // Ticks left before the power-up ends
+    uint64_t tick; // Number of steps since the last reset
+    int eatenRow, eatenCol; // Cell whose pellet was eaten during the last step (-1 if none)
+    int caughtBy; // Enemy that cost Pacman a life during the last step (-1 if none)
+    uint8_t events; // StepEvent bits for the last step
+    uint64_t seed; // Applied to the RNG on every reset, so a seed and the inputs fully determine a game
+    Rng rng;
+    GhostPolicy ghostPolicy;
+    bool ghostSeparation; // Enemies do not step into a cell another enemy stands on
+    // Only enemies within this many maze tiles (mazeTileSize-cell chunks) of Pacman's tile move, and
+    // the chase field stops at that block, so a tick costs the same on any maze size; 0 = everything moves
+    int activeRadius;
+    bool scatterMode; // ChaseScatter ghosts are heading for their corners
+    int modeRemaining; // Ticks left before switching between scatter and chase
+    Profiler *profiler; // Optional, not owned: receives per-phase timings of step()
+
+private:
+    int tickRate;
+    Level level; // Layout the maze is built from
+    uint64_t levelId;
+    Maze startMaze; // Freshly built maze, shared with 'maze' on every reset
+    int startDots, startPowerPellets;
+    Point pacmanSpawn;
+    std::vector<Point> enemySpawns; // 'E' cells, reused round-robin when there are more enemies
+    std::vector<int> enemyScratch; // Per-tick flags, kept to avoid reallocating every step
+    std::vector<int> enemyCrowded; // Per-tick flags: next cell taken by another enemy (ghostSeparation)
+    std::vector<int> enemyHits; // Result of findEnemyHits, through enemyGrid when current
+    SpatialHash enemyGrid; // Enemies bucketed by cell, maintained while ghostSeparation is on
+    bool enemyGridValid; // enemyGrid matches the current enemy positions
+    FlowField chaseField; // Distances to Pacman's cell, recomputed only when he changes cells
+    FlowField scatterFields[4]; // Distances to the four corners (see scatterClearance), computed once per maze
+    // Enemy indices sorted by GhostState (ascending within a state); group s is
+    // ghostOrder[ghostGroupStart[s]] up to ghostOrder[ghostGroupStart[s + 1]]
+    std::vector<int> ghostOrder;
+    int ghostGroupStart[ghostStateCount + 1];
+    bool ghostGroupsValid; // ghostOrder matches enemies.state
+
+    void initializeMaze(); // Build startMaze and the corner flow fields from the level, and take a new levelId
+    void markCrowdedEnemies(); // Fill enemyCrowded from the enemies' current cells
+    void steerEnemies(); // Point every enemy along the flow fields (ChaseScatter policy)
+    void steerPersonalities(); // Steer each GhostState group in one pass (Personalities policy)
+    void advanceGhostMode(); // Count down the scatter/chase timer and switch when it runs out
+    void applyGhostEvent(GhostEvent event); // Move every enemy to its personality's next state
+    void groupGhostsByState(); // Rebuild ghostOrder and ghostGroupStart from enemies.state
+    Point nearestOpenCell(int row, int col) const; // Closest non-wall cell as (col, row)
+    CellBox activeArea() const; // Cells simulated this tick, see activeRadius
+    void changeEnemyDirection(int index); // Change direction for specific enemy
+    void startPowerUp();
+    void endPowerUp();
+};
+
+#endif // GAMESTATE_H
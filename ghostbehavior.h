@@ -0,0 +1,51 @@
+#ifndef GHOSTBEHAVIOR_H
+#define GHOSTBEHAVIOR_H
+
+#include <cstdint>
+
+// Ghost personalities as data (GhostPolicy::Personalities). Each ghost is in one GhostState, which
+// decides how it steers; game events move it to another state through its personality's row of
+// the table below. Ghosts are steered one state at a time, so a new behavior is a new state, a
+// steering loop in GameState and a column in the table, not a per-ghost virtual call.
+
+enum class GhostState : uint8_t {
+    Chase, // Head for Pacman's cell
+    Ambush, // Head for the cell a few steps ahead of Pacman
+    Patrol, // Tour the four corners in turn
+    Scatter, // Head for the ghost's own corner
+    Flee, // Run from Pacman
+    Wander // Keep going, turn at random when blocked
+};
+static const int ghostStateCount = 6;
+
+// What moves a ghost to another state
+enum class GhostEvent : uint8_t {
+    ScatterPhase, // The mode timer switched to scatter, or a power-up ended in scatter
+    ChasePhase, // The mode timer switched to chase, or a power-up ended in chase
+    PowerUp, // Pacman ate a power pellet
+    Respawn // This ghost was eaten and restarts from its spawn cell
+};
+static const int ghostEventCount = 4;
+
+struct GhostPersonality {
+    const char *name;
+    GhostState next[ghostEventCount]; // State entered on each GhostEvent
+};
+
+// Assigned round-robin by enemy index. Eaten ghosts leave their spawn for their corner rather
+// than straight back into Pacman, and keep doing so until the next phase change
+constexpr GhostPersonality ghostPersonalities[] = {
+    {"chaser", {GhostState::Scatter, GhostState::Chase, GhostState::Flee, GhostState::Scatter}},
+    {"ambusher", {GhostState::Scatter, GhostState::Ambush, GhostState::Flee, GhostState::Scatter}},
+    {"patroller", {GhostState::Patrol, GhostState::Patrol, GhostState::Flee, GhostState::Patrol}},
+    {"wanderer", {GhostState::Wander, GhostState::Chase, GhostState::Flee, GhostState::Wander}},
+};
+static const int ghostPersonalityCount = sizeof(ghostPersonalities) / sizeof(ghostPersonalities[0]);
+
+inline const GhostPersonality &ghostPersonality(int enemyIndex) {
+    return ghostPersonalities[enemyIndex % ghostPersonalityCount];
+}
+
+static const int ambushLead = 4; // Cells ahead of Pacman an ambusher aims for
+
+#endif // GHOSTBEHAVIOR_H
@@ -0,0 +1,333 @@
+#include "inputpolicy.h"
+#include "threadpool.h"
+#include <limits>
+
+namespace {
+
+class IdlePolicy : public InputPolicy {
+public:
+    Input decide(const GameState &) override { return Input::None; }
+};
+
+Input inputFromExit(uint8_t bit) {
+    switch (bit) {
+    case ExitRight:
+        return Input::Right;
+    case ExitLeft:
+        return Input::Left;
+    case ExitDown:
+        return Input::Down;
+    case ExitUp:
+        return Input::Up;
+    default:
+        return Input::None;
+    }
+}
+
+// Search values are in score points
+const double deathPenalty = 1000;
+const double winBonus = 5000;
+const double distanceCost = 1; // Per cell between the rollout's end and the nearest pellet
+
+const struct {
+    Input input;
+    uint8_t exit;
+    uint8_t reverse;
+} directions[4] = {
+    {Input::Right, ExitRight, ExitLeft},
+    {Input::Left, ExitLeft, ExitRight},
+    {Input::Down, ExitDown, ExitUp},
+    {Input::Up, ExitUp, ExitDown}
+};
+
+uint8_t headingExit(const PacmanState &pacman) {
+    return (pacman.dx > 0 ? ExitRight : 0) | (pacman.dx < 0 ? ExitLeft : 0)
+        | (pacman.dy > 0 ? ExitDown : 0) | (pacman.dy < 0 ? ExitUp : 0);
+}
+
+// Rollout player: at cell centers, turn into a random open direction other than straight back
+Input randomTurn(const GameState &game, Rng &rng) {
+    const int cellSize = GameState::cellSize;
+    const PacmanState &pacman = game.pacman;
+    if (pacman.x % cellSize != cellSize / 2 || pacman.y % cellSize != cellSize / 2)
+        return Input::None;
+
+    uint8_t exits = game.maze.exits(pacman.y / cellSize, pacman.x / cellSize);
+    uint8_t heading = headingExit(pacman);
+    Input options[4];
+    int count = 0;
+    for (const auto &direction : directions) {
+        if ((exits & direction.exit) && direction.reverse != heading)
+            options[count++] = direction.input;
+    }
+    if (count == 0) {
+        for (const auto &direction : directions) {
+            if (exits & direction.exit)
+                options[count++] = direction.input; // Dead end: going back is the only way
+        }
+    }
+    return count > 0 ? options[rng.bounded(count)] : Input::None;
+}
+
+} // namespace
+
+Input RandomPolicy::decide(const GameState &) {
+    return static_cast<Input>(1 + rng.bounded(4));
+}
+
+Input GreedyPolicy::decide(const GameState &game) {
+    const int cellSize = GameState::cellSize;
+    const PacmanState &pacman = game.pacman;
+    // Pacman can only turn on a cell center; in between, keep the buffered direction
+    if (pacman.x % cellSize != cellSize / 2 || pacman.y % cellSize != cellSize / 2)
+        return Input::None;
+
+    const MazeView maze = game.maze.view();
+    const int startRow = pacman.y / cellSize;
+    const int startCol = pacman.x / cellSize;
+    if (!maze.contains(startRow, startCol))
+        return Input::None;
+
+    const size_t cellCount = static_cast<size_t>(maze.width) * maze.height;
+    if (visited.size() != cellCount) {
+        visited.assign(cellCount, 0);
+        firstStep.assign(cellCount, 0);
+        queue.resize(cellCount);
+        generation = 0;
+    }
+    if (++generation == 0) { // Stamps wrapped around: start over
+        visited.assign(cellCount, 0);
+        generation = 1;
+    }
+
+    const int start = startRow * maze.width + startCol;
+    const int offsets[4] = {1, -1, maze.width, -maze.width};
+    const uint8_t bits[4] = {ExitRight, ExitLeft, ExitDown, ExitUp};
+    size_t head = 0;
+    size_t tail = 0;
+    visited[start] = generation;
+    firstStep[start] = 0;
+    queue[tail++] = start;
+
+    while (head < tail) {
+        int cell = queue[head++];
+        MazeItem item = maze.at(cell / maze.width, cell % maze.width);
+        if (cell != start && (item == MazeItem::Dot || item == MazeItem::PowerPellet))
+            return inputFromExit(firstStep[cell]);
+
+        uint8_t exits = maze.exitMask[cell];
+        for (int d = 0; d < 4; d++) {
+            int next = cell + offsets[d];
+            if ((exits & bits[d]) && visited[next] != generation) {
+                visited[next] = generation;
+                firstStep[next] = cell == start ? bits[d] : firstStep[cell];
+                queue[tail++] = next;
+            }
+        }
+    }
+    return Input::None;
+}
+
+SearchPolicy::SearchPolicy(uint64_t seed, const SearchSettings &settings)
+    : settings(settings), seed(seed), decisions(0), pelletLevelId(0), pelletsLeft(-1), pelletScanRow(0),
+    pelletHead(0), pelletTail(0), rolloutsDone(0)
+{
+    if (this->settings.threads != 1) {
+        pool.reset(new ThreadPool(this->settings.threads));
+        this->settings.threads = pool->size();
+    }
+    stats.resize(this->settings.threads);
+}
+
+SearchPolicy::~SearchPolicy() = default;
+
+void SearchPolicy::prepareScratch(const GameState &game) {
+    // Rollout states are full copies made once per level and settings; after that every
+    // rollout restores a snapshot into them, reusing their buffers. restore() needs the same
+    // level, so a different layout of the same size still rebuilds them
+    const GameState &first = scratch.empty() ? game : scratch.front();
+    if (scratch.size() == static_cast<size_t>(settings.threads) && first.getLevelId() == game.getLevelId()
+        && first.enemyCount() == game.enemyCount() && first.ghostPolicy == game.ghostPolicy
+        && first.ghostSeparation == game.ghostSeparation && first.activeRadius == game.activeRadius
+        && first.getTickRate() == game.getTickRate())
+        return;
+
+    scratch.assign(settings.threads, game);
+    for (GameState &state : scratch) {
+        state.profiler = nullptr; // The profiler has a single writer: the real game
+    }
+}
+
+Input SearchPolicy::decide(const GameState &game) {
+    const int cellSize = GameState::cellSize;
+    const PacmanState &pacman = game.pacman;
+    // Pacman can only turn on a cell center; in between, keep the buffered direction
+    if (pacman.x % cellSize != cellSize / 2 || pacman.y % cellSize != cellSize / 2)
+        return Input::None;
+    const int row = pacman.y / cellSize;
+    const int col = pacman.x / cellSize;
+    if (!game.maze.contains(row, col))
+        return Input::None;
+
+    Candidate candidates[4];
+    int candidateCount = 0;
+    uint8_t exits = game.maze.exits(row, col);
+    for (const auto &direction : directions) {
+        if (exits & direction.exit)
+            candidates[candidateCount++] = Candidate{direction.input, direction.exit};
+    }
+    rolloutsDone = 0;
+    if (candidateCount <= 1)
+        return candidateCount == 1 ? candidates[0].input : Input::None;
+
+    // The pellet field gets at most half the budget, the rollouts the rest
+    const auto start = std::chrono::steady_clock::now();
+    const bool timed = settings.budgetMs > 0;
+    const auto deadline = timed ? start + std::chrono::milliseconds(settings.budgetMs)
+                                : std::chrono::steady_clock::time_point::max();
+    prepareScratch(game);
+    computePelletDistance(game, timed ? start + std::chrono::microseconds(settings.budgetMs * 500) : deadline);
+    const GameSnapshot root = game.snapshot();
+    decisions++;
+    for (WorkerStats &worker : stats) {
+        worker = WorkerStats();
+    }
+
+    if (pool) {
+        for (int w = 0; w < settings.threads; w++) {
+            pool->submit([&, w]() { runRollouts(w, root, candidates, candidateCount, deadline); });
+        }
+        pool->wait();
+    } else {
+        runRollouts(0, root, candidates, candidateCount, deadline);
+    }
+
+    Input best = Input::None;
+    double bestValue = 0;
+    for (int c = 0; c < candidateCount; c++) {
+        double total = 0;
+        int count = 0;
+        for (const WorkerStats &worker : stats) {
+            total += worker.total[c];
+            count += worker.count[c];
+        }
+        rolloutsDone += count;
+        if (count == 0)
+            continue;
+        double value = total / count;
+        if (best == Input::None || value > bestValue) {
+            best = candidates[c].input;
+            bestValue = value;
+        }
+    }
+    return best;
+}
+
+void SearchPolicy::computePelletDistance(const GameState &game, std::chrono::steady_clock::time_point deadline) {
+    // Breadth-first search outwards from every pellet at once. Walls never change, so the field
+    // holds until a pellet is eaten. When the deadline cuts it short, the next decision picks up
+    // where it stopped; distances already set are final, and unreached cells cost nothing
+    const MazeView maze = game.maze.view();
+    const int width = maze.width;
+    const int pellets = game.remainingDots + game.remainingPowerPellets;
+    if (pelletLevelId != game.getLevelId() || pelletsLeft != pellets) {
+        pelletLevelId = game.getLevelId();
+        pelletsLeft = pellets;
+        const size_t cellCount = static_cast<size_t>(width) * maze.height;
+        pelletDistance.assign(cellCount, -1);
+        queue.resize(cellCount);
+        pelletScanRow = 0;
+        pelletHead = 0;
+        pelletTail = 0;
+    }
+
+    // Every pellet goes in the queue before the search expands any of them
+    for (; pelletScanRow < maze.height; pelletScanRow++) {
+        if (std::chrono::steady_clock::now() >= deadline)
+            return;
+        const int row = pelletScanRow;
+        for (int col = 0; col < width; col++) {
+            MazeItem item = maze.at(row, col);
+            if (item == MazeItem::Dot || item == MazeItem::PowerPellet) {
+                pelletDistance[static_cast<size_t>(row) * width + col] = 0;
+                queue[pelletTail++] = row * width + col;
+            }
+        }
+    }
+
+    const int offsets[4] = {1, -1, width, -width};
+    const uint8_t bits[4] = {ExitRight, ExitLeft, ExitDown, ExitUp};
+    size_t head = pelletHead;
+    size_t tail = pelletTail;
+    while (head < tail) {
+        if ((head & 4095) == 0 && std::chrono::steady_clock::now() >= deadline)
+            break;
+        int cell = queue[head++];
+        uint8_t exits = maze.exitMask[cell];
+        for (int d = 0; d < 4; d++) {
+            int next = cell + offsets[d];
+            if ((exits & bits[d]) && pelletDistance[next] < 0) {
+                pelletDistance[next] = pelletDistance[cell] + 1;
+                queue[tail++] = next;
+            }
+        }
+    }
+    pelletHead = head;
+    pelletTail = tail;
+}
+
+void SearchPolicy::runRollouts(int worker, const GameSnapshot &root, const Candidate *candidates, int candidateCount,
+                               std::chrono::steady_clock::time_point deadline) {
+    GameState &state = scratch[worker];
+    WorkerStats &mine = stats[worker];
+    const int total = settings.rolloutsPerMove * candidateCount;
+
+    // Rollout i always explores candidate i % count with the same seed, whichever thread runs it,
+    // so results only depend on the thread count when the budget runs out
+    for (int i = worker; i < total; i += settings.threads) {
+        if (std::chrono::steady_clock::now() >= deadline)
+            return;
+        uint64_t rolloutSeed = Rng(seed ^ (decisions << 32) ^ static_cast<uint64_t>(i)).next();
+        int c = i % candidateCount;
+        double value = rollout(state, root, candidates[c].input, rolloutSeed, deadline);
+        if (value != value) // NaN: cut off by the deadline
+            return;
+        mine.total[c] += value;
+        mine.count[c]++;
+    }
+}
+
+double SearchPolicy::rollout(GameState &state, const GameSnapshot &root, Input first, uint64_t rolloutSeed,
+                             std::chrono::steady_clock::time_point deadline) const {
+    state.restore(root);
+    state.rng.seed(rolloutSeed); // Enemies take different random turns in every rollout
+    Rng turns(rolloutSeed ^ 0xD1B54A32D192ED03ULL);
+
+    Input input = first;
+    for (int t = 0; t < settings.depth && !state.isOver(); t++) {
+        if ((t & 7) == 7 && std::chrono::steady_clock::now() >= deadline)
+            return std::numeric_limits<double>::quiet_NaN();
+        state.step(input);
+        if (state.lives < root.lives)
+            return state.score - root.score - deathPenalty;
+        input = randomTurn(state, turns);
+    }
+
+    double value = state.score - root.score + (state.won ? winBonus : 0);
+    int cell = (state.pacman.y / GameState::cellSize) * state.maze.width() + state.pacman.x / GameState::cellSize;
+    if (pelletDistance[cell] > 0)
+        value -= distanceCost * pelletDistance[cell];
+    return value;
+}
+
+std::unique_ptr<InputPolicy> makeInputPolicy(const std::string &name, uint64_t seed) {
+    if (name == "none")
+        return std::unique_ptr<InputPolicy>(new IdlePolicy());
+    if (name == "random")
+        return std::unique_ptr<InputPolicy>(new RandomPolicy(seed));
+    if (name == "greedy")
+        return std::unique_ptr<InputPolicy>(new GreedyPolicy());
+    if (name == "search")
+        return std::unique_ptr<InputPolicy>(new SearchPolicy(seed));
+    return nullptr;
+}
@@ -0,0 +1,100 @@
+#ifndef INPUTPOLICY_H
+#define INPUTPOLICY_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "gamestate.h"
+
+// Decides the direction fed to GameState::step each tick, i.e. what a player's arrow keys would send
+class InputPolicy {
+public:
+    virtual ~InputPolicy() = default;
+    virtual Input decide(const GameState &game) = 0;
+};
+
+// Presses a random arrow key every tick
+class RandomPolicy : public InputPolicy {
+public:
+    explicit RandomPolicy(uint64_t seed) : rng(seed) {}
+    Input decide(const GameState &game) override;
+
+private:
+    Rng rng;
+};
+
+// Heads for the nearest remaining pellet along the shortest path, ignoring enemies
+class GreedyPolicy : public InputPolicy {
+public:
+    Input decide(const GameState &game) override;
+
+private:
+    std::vector<uint32_t> visited; // Generation stamp per cell, so buffers never need clearing
+    std::vector<uint8_t> firstStep; // Exit bit taken out of Pacman's cell on the way to each cell
+    std::vector<int> queue;
+    uint32_t generation = 0;
+};
+
+class ThreadPool;
+
+struct SearchSettings {
+    int threads = 1; // Rollout threads; 0 = one per hardware core
+    int budgetMs = 40; // Hard limit per decision, well inside one 100 ms tick; 0 = no limit, so runs are reproducible
+    int rolloutsPerMove = 64; // Upper limit, so untimed runs are reproducible
+    int depth = 60; // Ticks simulated per rollout (six cells at Pacman's speed)
+};
+
+// Monte Carlo lookahead: at each cell center, simulates many futures for every open direction
+// (random Pacman turns, enemies reseeded per rollout) and picks the best average outcome.
+// A rollout scores the points it made, minus a penalty for dying and minus the distance
+// left to the nearest pellet, so Pacman keeps heading for food when no danger is in sight.
+// Rollout games are restored from a snapshot into per-thread scratch states built once,
+// and the maze tiles a rollout copies to eat pellets from are reused by the next one, so after
+// the first few decisions rollouts do not allocate
+class SearchPolicy : public InputPolicy {
+public:
+    explicit SearchPolicy(uint64_t seed, const SearchSettings &settings = SearchSettings());
+    ~SearchPolicy() override;
+    Input decide(const GameState &game) override;
+
+    int lastRollouts() const { return rolloutsDone; } // Rollouts the last search finished in its budget
+
+private:
+    struct Candidate {
+        Input input;
+        uint8_t exit;
+    };
+    struct WorkerStats {
+        double total[4] = {0, 0, 0, 0};
+        int count[4] = {0, 0, 0, 0};
+    };
+
+    SearchSettings settings;
+    uint64_t seed;
+    uint64_t decisions;
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<GameState> scratch; // One rollout state per thread
+    std::vector<WorkerStats> stats;
+    std::vector<int> pelletDistance; // Steps from each cell to the nearest pellet, -1 if none or not reached yet
+    std::vector<int> queue;
+    // pelletDistance is for this level and pellet count; the search resumes from these positions
+    uint64_t pelletLevelId;
+    int pelletsLeft;
+    int pelletScanRow;
+    size_t pelletHead, pelletTail;
+    int rolloutsDone;
+
+    void prepareScratch(const GameState &game);
+    void computePelletDistance(const GameState &game, std::chrono::steady_clock::time_point deadline);
+    void runRollouts(int worker, const GameSnapshot &root, const Candidate *candidates, int candidateCount,
+                     std::chrono::steady_clock::time_point deadline);
+    double rollout(GameState &state, const GameSnapshot &root, Input first, uint64_t rolloutSeed,
+                   std::chrono::steady_clock::time_point deadline) const; // NaN if cut off by the deadline
+};
+
+// Builds a policy by name ("none", "random", "greedy", "search"); returns nullptr for unknown names
+std::unique_ptr<InputPolicy> makeInputPolicy(const std::string &name, uint64_t seed);
+
+#endif // INPUTPOLICY_H
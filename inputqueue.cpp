@@ -0,0 +1,24 @@
+#include "inputqueue.h"
+
+void InputQueue::push(Input input, int64_t timeNs) {
+    if (tail - head == capacity) {
+        head++;
+    }
+    presses[tail % capacity] = Press{input, timeNs};
+    tail++;
+}
+
+Input InputQueue::take(int64_t timeNs, int64_t *pressedNs) {
+    Input latest = Input::None;
+    while (head != tail && presses[head % capacity].timeNs <= timeNs) {
+        const Press &press = presses[head % capacity];
+        latest = press.input;
+        if (pressedNs)
+            *pressedNs = press.timeNs;
+        head++;
+    }
+    if (head == tail) {
+        head = tail = 0;
+    }
+    return latest;
+}
@@ -0,0 +1,31 @@
+#ifndef INPUTQUEUE_H
+#define INPUTQUEUE_H
+
+#include <cstdint>
+#include "gamestate.h"
+
+// Key presses with the time they happened, so each one is applied by the simulation tick
+// whose time span contains it, even when a stalled frame runs several ticks at once
+class InputQueue {
+public:
+    static const int capacity = 16; // Oldest presses are dropped beyond this
+
+    void push(Input input, int64_t timeNs);
+    // Remove every press made at or before timeNs and return the latest of them (None if there
+    // were none); its time goes to pressedNs
+    Input take(int64_t timeNs, int64_t *pressedNs = nullptr);
+    void clear() { head = tail = 0; }
+    bool empty() const { return head == tail; }
+
+private:
+    struct Press {
+        Input input;
+        int64_t timeNs;
+    };
+
+    Press presses[capacity];
+    int head = 0; // Total presses taken
+    int tail = 0; // Total presses pushed
+};
+
+#endif // INPUTQUEUE_H
@@ -0,0 +1,185 @@
+#include "levelgen.h"
+#include "gamestate.h"
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+// Rooms are the cells at odd coordinates; the cell between two neighboring rooms is their wall
+class RoomGrid {
+public:
+    RoomGrid(Level &level) : level(level), rows((level.height - 1) / 2), cols((level.width - 1) / 2) {}
+
+    Level &level;
+    const int rows, cols;
+
+    int count() const { return rows * cols; }
+    char &cell(int row, int col) { return level.cells[static_cast<size_t>(row) * level.width + col]; }
+    char &room(int index) { return cell(2 * (index / cols) + 1, 2 * (index % cols) + 1); }
+
+    // Neighbor of room 'index' in direction d (0 right, 1 left, 2 down, 3 up), or -1 at the edge
+    int neighbor(int index, int d) const {
+        int r = index / cols, c = index % cols;
+        switch (d) {
+        case 0: return c + 1 < cols ? index + 1 : -1;
+        case 1: return c > 0 ? index - 1 : -1;
+        case 2: return r + 1 < rows ? index + cols : -1;
+        default: return r > 0 ? index - cols : -1;
+        }
+    }
+    char &wall(int index, int d) {
+        static const int dr[4] = {0, 0, 1, -1}, dc[4] = {1, -1, 0, 0};
+        return cell(2 * (index / cols) + 1 + dr[d], 2 * (index % cols) + 1 + dc[d]);
+    }
+    int openings(int index) {
+        int n = 0;
+        for (int d = 0; d < 4; d++) {
+            n += neighbor(index, d) >= 0 && wall(index, d) != 'W';
+        }
+        return n;
+    }
+};
+
+// Randomized depth-first search with an explicit stack: long winding corridors, one path between
+// any two rooms
+void carveSpanningTree(RoomGrid &grid, Rng &rng) {
+    std::vector<uint8_t> visited(grid.count(), 0);
+    std::vector<int> stack;
+    stack.reserve(grid.count());
+    int start = rng.bounded(grid.count());
+    visited[start] = 1;
+    stack.push_back(start);
+
+    while (!stack.empty()) {
+        int current = stack.back();
+        int options[4], optionCount = 0;
+        for (int d = 0; d < 4; d++) {
+            int next = grid.neighbor(current, d);
+            if (next >= 0 && !visited[next])
+                options[optionCount++] = d;
+        }
+        if (optionCount == 0) {
+            stack.pop_back();
+            continue;
+        }
+        int d = options[rng.bounded(optionCount)];
+        int next = grid.neighbor(current, d);
+        grid.wall(current, d) = 'D';
+        visited[next] = 1;
+        stack.push_back(next);
+    }
+}
+
+bool chance(Rng &rng, double probability) {
+    return probability >= 1.0 || (probability > 0.0 && (rng.next() >> 11) * (1.0 / 9007199254740992.0) < probability);
+}
+
+} // namespace
+
+Level generateLevel(int width, int height, uint64_t seed, const LevelGenSettings &settings) {
+    Level level;
+    level.width = std::max(3, width);
+    level.height = std::max(3, height);
+    level.cells.assign(static_cast<size_t>(level.width) * level.height, 'W');
+    Rng rng(seed);
+
+    RoomGrid grid(level);
+    for (int i = 0; i < grid.count(); i++) {
+        grid.room(i) = 'D';
+    }
+    carveSpanningTree(grid, rng);
+
+    // Open each dead end towards a neighbor, preferring another dead end so one opening fixes both
+    for (int i = 0; i < grid.count(); i++) {
+        if (grid.openings(i) != 1 || !chance(rng, settings.deadEndRemoval))
+            continue;
+        int options[4], optionCount = 0, preferred = -1;
+        for (int d = 0; d < 4; d++) {
+            int next = grid.neighbor(i, d);
+            if (next < 0 || grid.wall(i, d) != 'W')
+                continue;
+            options[optionCount++] = d;
+            if (grid.openings(next) == 1)
+                preferred = d;
+        }
+        if (optionCount > 0)
+            grid.wall(i, preferred >= 0 ? preferred : options[rng.bounded(optionCount)]) = 'D';
+    }
+
+    // Extra loops: each room's right and down walls are considered once
+    if (settings.extraOpenings > 0.0) {
+        for (int i = 0; i < grid.count(); i++) {
+            for (int d = 0; d <= 2; d += 2) {
+                if (grid.neighbor(i, d) >= 0 && grid.wall(i, d) == 'W' && chance(rng, settings.extraOpenings))
+                    grid.wall(i, d) = 'D';
+            }
+        }
+    }
+
+    // Power pellets near the corners and scattered by count, then enemy spawns away from the
+    // start, then the start itself in the room nearest the center
+    const int last = grid.count() - 1;
+    const int corners[4] = {0, grid.cols - 1, last - (grid.cols - 1), last};
+    for (int corner : corners) {
+        grid.room(corner) = 'N';
+    }
+    if (settings.roomsPerPowerPellet > 0) {
+        for (int n = grid.count() / settings.roomsPerPowerPellet; n > 0; n--) {
+            grid.room(rng.bounded(grid.count())) = 'N';
+        }
+    }
+
+    const int startRow = (grid.rows - 1) / 2, startCol = (grid.cols - 1) / 2;
+    const int start = startRow * grid.cols + startCol;
+    const int minDistance = (grid.rows + grid.cols) / 4;
+    for (int e = 0; e < settings.enemySpawns && grid.count() > 1; e++) {
+        // Rejection sampling; small mazes may have no room far enough away, so the last candidate stands
+        int room = -1;
+        for (int attempt = 0; attempt < 64; attempt++) {
+            int candidate = rng.bounded(grid.count());
+            if (candidate == start || grid.room(candidate) == 'E')
+                continue;
+            room = candidate;
+            if (std::abs(candidate / grid.cols - startRow) + std::abs(candidate % grid.cols - startCol) >= minDistance)
+                break;
+        }
+        if (room >= 0)
+            grid.room(room) = 'E';
+    }
+    grid.room(start) = 'S';
+    return level;
+}
+
+int unreachableCells(const Level &level) {
+    const int cellCount = level.width * level.height;
+    int open = 0, start = -1;
+    for (int i = 0; i < cellCount; i++) {
+        if (level.cells[i] != 'W')
+            open++;
+        if (level.cells[i] == 'S' && start < 0)
+            start = i;
+    }
+    if (start < 0)
+        return open;
+
+    // Breadth-first flood from the start; the queue doubles as the visited list
+    std::vector<uint8_t> seen(cellCount, 0);
+    std::vector<int> queue;
+    queue.reserve(open);
+    queue.push_back(start);
+    seen[start] = 1;
+    for (size_t head = 0; head < queue.size(); head++) {
+        int cell = queue[head];
+        int row = cell / level.width, col = cell % level.width;
+        const int neighbors[4] = {col + 1 < level.width ? cell + 1 : -1, col > 0 ? cell - 1 : -1,
+                                  row + 1 < level.height ? cell + level.width : -1, row > 0 ? cell - level.width : -1};
+        for (int next : neighbors) {
+            if (next >= 0 && !seen[next] && level.cells[next] != 'W') {
+                seen[next] = 1;
+                queue.push_back(next);
+            }
+        }
+    }
+    return open - static_cast<int>(queue.size());
+}
@@ -0,0 +1,24 @@
+#ifndef LEVELGEN_H
+#define LEVELGEN_H
+
+#include <cstdint>
+#include "maze.h"
+
+struct LevelGenSettings {
+    double deadEndRemoval = 1.0; // Share of dead ends opened into a loop (Pacman mazes have none)
+    double extraOpenings = 0.05; // Share of the remaining inner walls knocked out for more loops
+    int enemySpawns = 4;
+    int roomsPerPowerPellet = 500; // Beyond the four near the corners
+};
+
+// Pacman-style maze in the level cell vocabulary, the same for the same seed and settings.
+// Corridors are carved as a spanning tree over a lattice of odd cells, so every dot is reachable
+// from 'S'; later steps only remove walls. Even sizes leave a double wall on the right or bottom.
+// Sizes below 3x3 are raised to 3x3
+Level generateLevel(int width, int height, uint64_t seed, const LevelGenSettings &settings = LevelGenSettings());
+
+// Open cells (anything but 'W') that cannot be walked to from the first 'S' cell; every open cell
+// counts when there is no 'S'. Zero means the level is fully connected
+int unreachableCells(const Level &level);
+
+#endif // LEVELGEN_H
@@ -1,8 +1,181 @@
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QRandomGenerator>
+#include <QDir>
+#include <cstring>
 #include "mainwindow.h"
+#include "levelgen.h"
+#ifdef PACMAN_QT_AUDIO
+#include "qtaudiobackend.h"
+#endif
+
+// Checked before QApplication exists, since the platform plugin is chosen when it is created
+static bool hasOption(int argc, char *argv[], const char *name) {
+    const size_t length = std::strlen(name);
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], name, length) == 0 && (argv[i][length] == '\0' || argv[i][length] == '='))
+            return true;
+    }
+    return false;
+}
+
 int main(int argc, char *argv[]) {
+    // Rendering to files needs no display: use the offscreen platform unless one was chosen
+    bool renderToFiles = hasOption(argc, argv, "--frames") || hasOption(argc, argv, "--yuv");
+    if (renderToFiles && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
     QApplication app(argc, argv);
-    MainWindow window; // Create main window for the game
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addPositionalArgument("level", "Optional level file (text or binary) instead of the built-in maze.");
+    QCommandLineOption generateOption("generate", "Play a generated WxH maze instead of the built-in one.", "size");
+    parser.addOption(generateOption);
+    QCommandLineOption levelSeedOption("level-seed", "With --generate: seed of the maze (default: random).", "seed");
+    parser.addOption(levelSeedOption);
+    QCommandLineOption enemiesOption("enemies", "Number of enemies.", "count",
+                                     QString::number(GameState::defaultEnemyCount));
+    parser.addOption(enemiesOption);
+    QCommandLineOption ghostAiOption("ghost-ai", "Enemy behavior: random, chase (chase/scatter flow field) or "
+                                     "personalities (chasers, ambushers, patrollers and wanderers).",
+                                     "policy", "random");
+    parser.addOption(ghostAiOption);
+    QCommandLineOption tickRateOption("tick-rate", "Simulation steps per second (sets the game speed).", "hz",
+                                      QString::number(GameState::defaultTickRate));
+    parser.addOption(tickRateOption);
+    QCommandLineOption separateOption("separate-ghosts", "Keep enemies from stepping onto each other.");
+    parser.addOption(separateOption);
+    QCommandLineOption activeRadiusOption("active-radius", "Only move enemies within this many 32x32-cell chunks of Pacman (default 0 = all).", "chunks", "0");
+    parser.addOption(activeRadiusOption);
+    QCommandLineOption turnWindowOption("turn-window", "Drop a turn that could not be taken within this many ms (default: keep it).", "ms", "0");
+    parser.addOption(turnWindowOption);
+    QCommandLineOption autoplayOption("autoplay", "Let a bot play: random, greedy or search (Monte Carlo lookahead).", "policy");
+    parser.addOption(autoplayOption);
+    QCommandLineOption recordOption("record", "Save the game as a replay file.", "file");
+    parser.addOption(recordOption);
+    QCommandLineOption replayOption("replay", "Play back a replay file and verify its final score and lives.", "file");
+    parser.addOption(replayOption);
+    QCommandLineOption fastOption("fast", "With --replay: run at maximum speed and only show the final frame.");
+    parser.addOption(fastOption);
+    QCommandLineOption profileOption("profile", "Show per-phase frame timings (toggle with F3).");
+    parser.addOption(profileOption);
+    QCommandLineOption traceOption("trace", "On exit, write recent frame timings as a Chrome trace-event JSON file.", "file");
+    parser.addOption(traceOption);
+    QCommandLineOption soundsOption("sounds", "Directory holding the sound effects.", "dir",
+                                    "Resources/PacManAdvancedSounds");
+    parser.addOption(soundsOption);
+    QCommandLineOption muteOption("mute", "Play no sound.");
+    parser.addOption(muteOption);
+    QCommandLineOption audioOutOption("audio-out", "Write the sound effects to a WAV file instead of the sound device.", "file");
+    parser.addOption(audioOutOption);
+    QCommandLineOption framesOption("frames", "Render without a window and save every frame as a PNG in this directory.", "dir");
+    parser.addOption(framesOption);
+    QCommandLineOption yuvOption("yuv", "Render without a window and write raw YUV 4:2:0 video to this file (- for stdout).", "file");
+    parser.addOption(yuvOption);
+    QCommandLineOption framesPerTickOption("frames-per-tick", "With --frames or --yuv: frames rendered per simulation step.", "count", "1");
+    parser.addOption(framesPerTickOption);
+    QCommandLineOption maxTicksOption("max-ticks", "With --frames or --yuv: stop after this many steps (default: at game over).", "count", "0");
+    parser.addOption(maxTicksOption);
+    parser.process(app);
+
+    Level level = defaultLevel();
+    if (!parser.positionalArguments().isEmpty()) {
+        std::string error;
+        if (!loadLevelFile(parser.positionalArguments().first().toStdString(), level, &error)) {
+            qWarning() << "Could not load level:" << QString::fromStdString(error);
+            return 1;
+        }
+    }
+    if (parser.isSet(generateOption)) {
+        QStringList size = parser.value(generateOption).split('x');
+        int width = size.first().toInt();
+        int height = size.size() > 1 ? size[1].toInt() : width;
+        if (width <= 0 || height <= 0) {
+            qWarning() << "Invalid maze size:" << parser.value(generateOption);
+            return 1;
+        }
+        uint64_t seed = parser.isSet(levelSeedOption) ? parser.value(levelSeedOption).toULongLong()
+                                                      : QRandomGenerator::global()->generate64();
+        level = generateLevel(width, height, seed);
+    }
+    int enemyCount = qMax(0, parser.value(enemiesOption).toInt());
+    const QString ghostAi = parser.value(ghostAiOption);
+    GhostPolicy ghostPolicy = ghostAi == "chase" ? GhostPolicy::ChaseScatter
+        : ghostAi == "personalities" ? GhostPolicy::Personalities : GhostPolicy::Random;
+
+    int tickRate = qMax(1, parser.value(tickRateOption).toInt());
+
+    MainWindow window(level, enemyCount, ghostPolicy, tickRate); // Create main window for the game
+    window.setGhostSeparation(parser.isSet(separateOption));
+    window.setActiveRadius(parser.value(activeRadiusOption).toInt());
+    window.setTurnWindow(parser.value(turnWindowOption).toInt());
+    window.setProfileOverlayVisible(parser.isSet(profileOption));
+    if (parser.isSet(traceOption)) {
+        window.setTracePath(parser.value(traceOption));
+    }
+    if (!parser.isSet(muteOption) && !renderToFiles) {
+        std::unique_ptr<AudioBackend> backend;
+        if (parser.isSet(audioOutOption)) {
+            backend.reset(new WavFileAudioBackend(parser.value(audioOutOption).toStdString()));
+        } else {
+#ifdef PACMAN_QT_AUDIO
+            backend.reset(new QtAudioBackend);
+#endif
+        }
+        // Relative sound directories are tried from the working directory, then next to the executable
+        QString soundDir = parser.value(soundsOption);
+        if (QDir::isRelativePath(soundDir) && !QDir(soundDir).exists()) {
+            soundDir = QDir(QCoreApplication::applicationDirPath()).filePath(soundDir);
+        }
+        QString error;
+        if (backend && !window.startAudio(soundDir, std::move(backend), &error)) {
+            qWarning() << "Sound disabled:" << error;
+        }
+    }
+    if (parser.isSet(autoplayOption)) {
+        QString name = parser.value(autoplayOption);
+        uint64_t seed = QRandomGenerator::global()->generate64();
+        std::unique_ptr<InputPolicy> policy;
+        if (name == "search") {
+            SearchSettings settings;
+            settings.threads = 0; // All cores, the rollouts run inside one 100 ms tick
+            policy.reset(new SearchPolicy(seed, settings));
+        } else {
+            policy = makeInputPolicy(name.toStdString(), seed);
+        }
+        if (!policy) {
+            qWarning() << "Unknown autoplay policy:" << name;
+            return 1;
+        }
+        window.setAutoplay(std::move(policy));
+    }
+    if (parser.isSet(replayOption)) {
+        QString error;
+        if (!window.playReplay(parser.value(replayOption), parser.isSet(fastOption), &error)) {
+            qWarning() << "Could not load replay:" << error;
+            return 1;
+        }
+    } else if (parser.isSet(recordOption)) {
+        window.recordTo(parser.value(recordOption));
+    }
+    if (renderToFiles) {
+        FrameWriter writer;
+        QString error;
+        bool opened = parser.isSet(framesOption)
+                          ? writer.open(parser.value(framesOption), FrameWriter::Format::Png, 0, &error)
+                          : writer.open(parser.value(yuvOption), FrameWriter::Format::Yuv, 1, &error);
+        int framesPerTick = qMax(1, parser.value(framesPerTickOption).toInt());
+        if (!opened || !window.renderOffscreen(writer, framesPerTick, parser.value(maxTicksOption).toLongLong(), &error)) {
+            qWarning() << "Rendering failed:" << error;
+            return 1;
+        }
+        qInfo().noquote() << QString("Rendered %1 frames of %2x%3 at %4 fps (%5 waits on the encoder)")
+                                 .arg(writer.framesWritten()).arg(window.width()).arg(window.height())
+                                 .arg(window.tickRate() * framesPerTick).arg(writer.stalls());
+        return 0;
+    }
     window.show(); // Show the window
     return app.exec(); // Start the Qt application loop
 }
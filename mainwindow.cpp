@@ -6,54 +6,38 @@
 #include <QDebug>
 #include <QRandomGenerator>
 #include <QPushButton>
+#include <QGuiApplication>
+#include <QScreen>
 
-bool checkWallCollision(int x, int y, int width, int height, const MazeItem maze[][20], int mazeWidth, int mazeHeight, int cellSize) {
-    QRectF rect(x, y, width, height);
-    int startX = qFloor(rect.left() / cellSize);
-    int endX = qFloor(rect.right() / cellSize);
-    int startY = qFloor(rect.top() / cellSize);
-    int endY = qFloor(rect.bottom() / cellSize);
-
-    if (static_cast<int>(rect.width()) > 0 && static_cast<int>(rect.right()) % cellSize == 0)
-        endX--;
-    if (static_cast<int>(rect.height()) > 0 && static_cast<int>(rect.bottom()) % cellSize == 0)
-        endY--;
-
-    startX = qMax(0, startX);
-    endX = qMin(mazeWidth - 1, endX);
-    startY = qMax(0, startY);
-    endY = qMin(mazeHeight - 1, endY);
-
-    for (int i = startY; i <= endY; ++i) {
-        for (int j = startX; j <= endX; ++j) {
-            if (i >= 0 && i < mazeHeight && j >= 0 && j < mazeWidth && maze[i][j] == MazeItem::Wall) {
-                return true;
-            }
-        }
-    }
-    return false;
-}
-
-MainWindow::MainWindow(QWidget *parent)
+MainWindow::MainWindow(const Level &level, int enemyCount, GhostPolicy ghostPolicy, int tickRate, QWidget *parent)
     : QMainWindow(parent), pacman(new Pacman(this)), timer(new QTimer(this)),
-    score(0), lives(3), gameEnded(false),
-    powerUpActive(false), powerUpTimer(new QTimer(this))
+    lastFrameNs(0), accumulatorNs(0), renderAlpha(0), spritesMoving(true), paused(false),
+    replaying(false), fastReplay(false),
+    game(level, QRandomGenerator::global()->generate64(), enemyCount), heldTurn(Input::None), heldSinceNs(0),
+    turnWindowNs(0), cancelHeldTurn(false), latencyPressNs(-1),
+    maxCachedChunks(0), paintCount(0), showProfile(false), lastProfileNs(0)
 {
-    setFixedSize(mazeWidth * cellSize, mazeHeight * cellSize);
-    initializeMaze();
+    game.profiler = &profiler;
+    game.ghostPolicy = ghostPolicy;
+    game.setTickRate(tickRate);
+    game.reset();
+    tickNs = 1000000000LL / game.getTickRate();
+
+    QScreen *screen = QGuiApplication::primaryScreen();
+    qreal refreshRate = screen ? screen->refreshRate() : 60.0;
+    frameInterval = qMax(1, qRound(1000.0 / (refreshRate > 0 ? refreshRate : 60.0)));
+    timer->setTimerType(Qt::PreciseTimer);
+
+    setFixedSize(viewSize());
+    pacman->setState(game.pacman);
+    renderMazeLayer();
     connect(timer, &QTimer::timeout, this, &MainWindow::gameLoop);
-    timer->start(100);
+    startLoop();
 
-    pacman->setX(cellSize * 1 + cellSize / 2);
-    pacman->setY(cellSize * 1 + cellSize / 2);
     setFocusPolicy(Qt::StrongFocus);
 
-    connect(powerUpTimer, &QTimer::timeout, this, &MainWindow::endPowerUp);
-    originalPacmanSpeed = 2;
-
-    enemyColors[0] = Qt::red;
-    enemyColors[1] = Qt::cyan;
-    enemyColors[2] = Qt::magenta;
+    enemyColors = {Qt::red, Qt::cyan, Qt::magenta};
+    sprites.build(cellSize, enemyColors, devicePixelRatioF());
 
     tryAgainButton = new QPushButton("Try Again", this);
     tryAgainButton->setGeometry(width()/2 - 50, height()/2 + 40, 100, 30);
@@ -62,296 +46,576 @@ MainWindow::MainWindow(QWidget *parent)
 }
 
 MainWindow::~MainWindow() {
+    audio.stop();
+    finishRecording();
+    if (!tracePath.isEmpty()) {
+        std::string error;
+        if (!profiler.writeChromeTrace(tracePath.toStdString(), &error)) {
+            qWarning() << "Could not write trace:" << QString::fromStdString(error);
+        }
+    }
     delete pacman;
     delete timer;
-    delete powerUpTimer;
     delete tryAgainButton;
 }
 
 void MainWindow::keyPressEvent(QKeyEvent *event) {
-    pacman->setNextDirection(event->key());
+    if (event->key() == Qt::Key_F3) {
+        setProfileOverlayVisible(!showProfile);
+        return;
+    }
+    if (event->key() == Qt::Key_P) {
+        setPaused(!paused);
+        return;
+    }
+    if (replaying || paused)
+        return;
+    Input input = Pacman::inputFromKey(event->key());
+    if (input != Input::None) {
+        inputQueue.push(input, clock.nsecsElapsed());
+    }
+}
+
+void MainWindow::resetGame() {
+    finishRecording();
+    replaying = false;
+    tryAgainButton->hide();
+    game.seed = QRandomGenerator::global()->generate64();
+    game.reset();
+    if (!recordPath.isEmpty()) {
+        recorder.begin(game);
+    }
+    restartView();
 }
 
-void MainWindow::resetPositions() {
-    // Reset Pacman
-    pacman->setX(cellSize * 1 + cellSize / 2);
-    pacman->setY(cellSize * 1 + cellSize / 2);
-    pacman->setNextDirection(Qt::Key_Right);
+void MainWindow::restartView() {
+    inputQueue.clear(); // The clock restarts, so old timestamps would be meaningless
+    heldTurn = Input::None;
+    cancelHeldTurn = false;
+    latencyPressNs = -1;
+    pacman->setState(game.pacman);
+    renderMazeLayer();
+    startLoop();
+    update();
+}
 
-    // Reset enemies to their initial positions
-    enemyPos[0].setX(cellSize * 9 + cellSize / 2);
-    enemyPos[0].setY(cellSize * 9 + cellSize / 2);
-    enemyPos[1].setX(cellSize * 9 + cellSize / 2);
-    enemyPos[1].setY(cellSize * 9 + cellSize / 2);
-    enemyPos[2].setX(cellSize * 15 + cellSize / 2);
-    enemyPos[2].setY(cellSize * 14 + cellSize / 2);
+void MainWindow::recordTo(const QString &path) {
+    recordPath = path;
+    recorder.begin(game);
+}
 
-    for (int i = 0; i < enemyCount; i++) {
-        changeEnemyDirection(i);
+void MainWindow::finishRecording() {
+    if (!recorder.isRecording())
+        return;
+    recorder.finish(game);
+    if (!recorder.save(recordPath.toStdString())) {
+        qWarning() << "Could not save replay to" << recordPath;
     }
 }
 
-void MainWindow::resetGame() {
-    lives = 3;
-    score = 0;
-    gameEnded = false;
-    tryAgainButton->hide();
-    initializeMaze();
-    resetPositions();
-    timer->start(100);
+bool MainWindow::playReplay(const QString &path, bool fast, QString *error) {
+    std::string message;
+    if (!replayPlayer.load(path.toStdString(), &message)) {
+        if (error)
+            *error = QString::fromStdString(message);
+        return false;
+    }
+
+    finishRecording();
+    recordPath.clear();
+    game = replayPlayer.createGame();
+    game.profiler = &profiler;
+    tickNs = 1000000000LL / game.getTickRate();
+    setFixedSize(viewSize());
+    replaying = true;
+    fastReplay = fast;
+    restartView();
+    return true;
+}
+
+void MainWindow::finishReplay() {
+    bool ok = replayPlayer.matches(game);
+    qInfo().noquote() << QString("Replay %1: tick %2, score %3, lives %4")
+                             .arg(ok ? "verified" : "MISMATCH")
+                             .arg(game.tick).arg(game.score).arg(game.lives);
+    setWindowTitle(ok ? "Replay verified" : "Replay MISMATCH");
+    replaying = false;
+    fastReplay = false;
+    stopLoop();
+    renderAlpha = 1.0;
+    updateCamera();
+    renderMazeLayer();
     update();
 }
 
-void MainWindow::initializeMaze() {
-    const char initialMaze[mazeHeight][mazeWidth] = {
-        {'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W'},
-        {'W', 'S', 'D', 'N', 'D', 'D', 'D', 'N', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'W'},
-        {'W', 'D', 'W', 'W', 'W', 'D', 'W', 'W', 'W', 'D', 'W', 'W', 'W', 'D', 'W', 'W', 'W', 'D', 'D', 'W'},
-        {'W', 'D', 'W', 'D', 'D', 'D', 'W', 'D', 'D', 'D', 'D', 'N', 'W', 'D', 'D', 'D', 'W', 'D', 'W', 'W'},
-        {'W', 'D', 'W', 'N', 'W', 'W', 'W', 'D', 'W', 'D', 'W', 'D', 'W', 'W', 'W', 'D', 'W', 'D', 'W', 'W'},
-        {'W', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'W', 'D', 'W', 'D', 'D', 'D', 'W', 'D', 'D', 'D', 'W', 'W'},
-        {'W', 'W', 'W', 'D', 'W', 'D', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'D', 'W', 'W', 'D', 'W', 'W', 'W'},
-        {'W', 'D', 'D', 'D', 'W', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'W'},
-        {'W', 'D', 'W', 'W', 'W', 'D', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'D', 'W', 'W', 'W', 'D', 'W', 'W'},
-        {'W', 'D', 'W', 'D', 'D', 'E', 'W', 'D', 'E', 'E', 'D', 'D', 'W', 'D', 'D', 'D', 'W', 'D', 'W', 'W'},
-        {'W', 'D', 'D', 'D', 'W', 'W', 'W', 'D', 'W', 'W', 'W', 'D', 'W', 'W', 'W', 'D', 'W', 'D', 'W', 'W'},
-        {'W', 'D', 'D', 'D', 'W', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'W', 'W'},
-        {'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'D', 'W', 'W'},
-        {'W', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'W', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'D', 'W'},
-        {'W', 'D', 'W', 'W', 'W', 'D', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'D', 'W', 'W', 'W', 'E', 'D', 'W'},
-        {'W', 'N', 'W', 'D', 'D', 'D', 'W', 'D', 'D', 'D', 'D', 'D', 'W', 'D', 'D', 'D', 'W', 'N', 'W', 'W'},
-        {'W', 'D', 'W', 'D', 'W', 'W', 'W', 'D', 'W', 'W', 'W', 'D', 'W', 'W', 'W', 'D', 'W', 'D', 'W', 'W'},
-        {'W', 'D', 'D', 'D', 'W', 'D', 'D', 'D', 'W', 'D', 'W', 'D', 'D', 'D', 'W', 'D', 'D', 'D', 'W', 'W'},
-        {'W', 'D', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'D', 'D', 'W'},
-        {'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W', 'W'}
-    };
+void MainWindow::startLoop() {
+    previousPacman = game.pacman;
+    previousEnemyX = game.enemies.x;
+    previousEnemyY = game.enemies.y;
+    lastSpriteRegion = QRegion();
+    accumulatorNs = 0;
+    renderAlpha = 0;
+    clock.start();
+    lastFrameNs = 0;
+    spritesMoving = true;
+    paused = false;
+    updateCamera();
+    audio.setPaused(false);
+    timer->start(frameInterval);
+}
+
+void MainWindow::stopLoop() {
+    timer->stop();
+    audio.setPaused(true);
+}
 
-    dotPositions.clear();
-    powerPellets.clear();
-
-    for (int i = 0; i < mazeHeight; ++i) {
-        for (int j = 0; j < mazeWidth; ++j) {
-            switch (initialMaze[i][j]) {
-            case 'W':
-                maze[i][j] = MazeItem::Wall;
-                break;
-            case 'D':
-                maze[i][j] = MazeItem::Dot;
-                dotPositions.append(getCellCenter(i, j));
-                break;
-            case 'P':
-                maze[i][j] = MazeItem::Path;
-                break;
-            case 'N':
-                maze[i][j] = MazeItem::PowerPellet;
-                powerPellets.append(getCellCenter(i, j));
-                break;
-            case 'S':
-                maze[i][j] = MazeItem::Path;
-                pacman->setX(j * cellSize + cellSize / 2);
-                pacman->setY(i * cellSize + cellSize / 2);
-                break;
-            case 'E':
-                maze[i][j] = MazeItem::Path;
-                for (int e = 0; e < enemyCount; e++) {
-                    if (enemyPos[e].isNull()) {
-                        enemyPos[e].setX(j * cellSize + cellSize / 2);
-                        enemyPos[e].setY(i * cellSize + cellSize / 2);
-                        enemyDx[e] = (e % 2 == 0) ? 2 : -2;
-                        enemyDy[e] = 0;
-                        changeEnemyDirection(e);
-                        break;
-                    }
+void MainWindow::setPaused(bool pause) {
+    // Only a running game can be paused: not a finished one, a finished replay or offscreen rendering
+    if (pause == paused || game.isOver() || fastReplay || (pause && !timer->isActive()))
+        return;
+    paused = pause;
+    if (paused) {
+        stopLoop();
+    } else {
+        // Carry on from the paused frame: the time spent paused is not simulated, and keys
+        // pressed before the pause are stale
+        inputQueue.clear();
+        heldTurn = Input::None;
+        cancelHeldTurn = false;
+        latencyPressNs = -1;
+        lastFrameNs = clock.nsecsElapsed();
+        audio.setPaused(false);
+        timer->start(frameInterval);
+    }
+    update();
+}
+
+void MainWindow::scheduleNextFrame() {
+    int interval = frameInterval;
+    if (!spritesMoving && !fastReplay) {
+        qint64 untilTickNs = qMax<qint64>(0, tickNs - accumulatorNs);
+        interval = qMax(1, static_cast<int>((untilTickNs + 999999) / 1000000));
+    }
+    if (!timer->isActive() || timer->interval() != interval) {
+        timer->start(interval);
+    }
+}
+
+QPoint MainWindow::getCellCenter(int row, int col) const {
+    return QPoint(col * cellSize + cellSize / 2, row * cellSize + cellSize / 2);
+}
+
+void MainWindow::renderMazeLayer() {
+    mazeChunks.clear();
+    // Enough for every chunk the window can overlap, plus a ring around it for the camera to move into
+    maxCachedChunks = (width() / chunkPixels + 3) * (height() / chunkPixels + 3);
+}
+
+const QPixmap &MainWindow::mazeChunk(int chunkRow, int chunkCol) {
+    const int chunksPerRow = (game.maze.width() + mazeTileMask) >> mazeTileShift;
+    const int key = chunkRow * chunksPerRow + chunkCol;
+    auto it = mazeChunks.find(key);
+    if (it == mazeChunks.end()) {
+        if (mazeChunks.size() >= maxCachedChunks) {
+            // Drop the chunk unused for longest, unless every cached chunk is on screen right now
+            auto oldest = mazeChunks.end();
+            for (auto candidate = mazeChunks.begin(); candidate != mazeChunks.end(); ++candidate) {
+                if (candidate->lastUsed < paintCount && (oldest == mazeChunks.end() || candidate->lastUsed < oldest->lastUsed))
+                    oldest = candidate;
+            }
+            if (oldest != mazeChunks.end())
+                mazeChunks.erase(oldest);
+        }
+
+        const int firstRow = chunkRow << mazeTileShift;
+        const int firstCol = chunkCol << mazeTileShift;
+        const int rows = qMin(mazeTileSize, game.maze.height() - firstRow);
+        const int cols = qMin(mazeTileSize, game.maze.width() - firstCol);
+        qreal dpr = devicePixelRatioF();
+        QPixmap pixmap(QSize(cols * cellSize, rows * cellSize) * dpr);
+        pixmap.setDevicePixelRatio(dpr);
+        pixmap.fill(Qt::black);
+
+        QPainter painter(&pixmap);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.setPen(Qt::NoPen);
+        painter.translate(-firstCol * cellSize, -firstRow * cellSize); // Draw in maze coordinates
+        for (int i = firstRow; i < firstRow + rows; ++i) {
+            for (int j = firstCol; j < firstCol + cols; ++j) {
+                QRect cellRect(j * cellSize, i * cellSize, cellSize, cellSize);
+                if (game.maze.at(i, j) == MazeItem::Wall) {
+                    painter.fillRect(cellRect, Qt::blue);
+                } else if (game.maze.at(i, j) == MazeItem::Dot) {
+                    painter.setBrush(Qt::yellow);
+                    painter.drawEllipse(getCellCenter(i, j), 3, 3);
+                } else if (game.maze.at(i, j) == MazeItem::PowerPellet) {
+                    painter.setBrush(Qt::white);
+                    painter.drawEllipse(getCellCenter(i, j), 7, 7);
                 }
-                break;
-            default:
-                maze[i][j] = MazeItem::Path;
-                break;
             }
         }
+        painter.end();
+        it = mazeChunks.insert(key, MazeChunk{pixmap, 0});
     }
+    it->lastUsed = paintCount;
+    return it->pixmap;
 }
 
-QPoint MainWindow::getCellCenter(int row, int col) const {
-    return QPoint(col * cellSize + cellSize / 2, row * cellSize + cellSize / 2);
+void MainWindow::eraseCell(int row, int col) {
+    // Chunks that are not cached get drawn from the maze, which no longer has the pellet
+    const int chunksPerRow = (game.maze.width() + mazeTileMask) >> mazeTileShift;
+    auto it = mazeChunks.find((row >> mazeTileShift) * chunksPerRow + (col >> mazeTileShift));
+    if (it == mazeChunks.end())
+        return;
+    QPainter painter(&it->pixmap);
+    painter.fillRect(QRect((col & mazeTileMask) * cellSize, (row & mazeTileMask) * cellSize, cellSize, cellSize), Qt::black);
 }
 
-void MainWindow::changeEnemyDirection(int index) {
-    QVector<QPoint> possibleDirections;
-    int enemyWidth = 16;
-    int enemyHeight = 16;
-    int targetX, targetY;
-
-    // Check right
-    targetX = enemyPos[index].x() + cellSize;
-    targetY = enemyPos[index].y();
-    if (!checkWallCollision(targetX - enemyWidth / 2, targetY - enemyHeight / 2, enemyWidth, enemyHeight, maze, mazeWidth, mazeHeight, cellSize))
-        possibleDirections.append(QPoint(cellSize, 0));
-
-    // Check left
-    targetX = enemyPos[index].x() - cellSize;
-    targetY = enemyPos[index].y();
-    if (!checkWallCollision(targetX - enemyWidth / 2, targetY - enemyHeight / 2, enemyWidth, enemyHeight, maze, mazeWidth, mazeHeight, cellSize))
-        possibleDirections.append(QPoint(-cellSize, 0));
-
-    // Check down
-    targetX = enemyPos[index].x();
-    targetY = enemyPos[index].y() + cellSize;
-    if (!checkWallCollision(targetX - enemyWidth / 2, targetY - enemyHeight / 2, enemyWidth, enemyHeight, maze, mazeWidth, mazeHeight, cellSize))
-        possibleDirections.append(QPoint(0, cellSize));
-
-    // Check up
-    targetX = enemyPos[index].x();
-    targetY = enemyPos[index].y() - cellSize;
-    if (!checkWallCollision(targetX - enemyWidth / 2, targetY - enemyHeight / 2, enemyWidth, enemyHeight, maze, mazeWidth, mazeHeight, cellSize))
-        possibleDirections.append(QPoint(0, -cellSize));
-
-    if (!possibleDirections.isEmpty()) {
-        int randomIndex = QRandomGenerator::global()->bounded(possibleDirections.size());
-        QPoint newDirection = possibleDirections[randomIndex];
-        enemyDx[index] = newDirection.x();
-        enemyDy[index] = newDirection.y();
-    }
-}
-
-void MainWindow::moveEnemy(int index) {
-    int targetX = enemyPos[index].x() + enemyDx[index];
-    int targetY = enemyPos[index].y() + enemyDy[index];
-    int enemyWidth = 16;
-    int enemyHeight = 16;
-
-    if (!checkWallCollision(targetX - enemyWidth / 2, targetY - enemyHeight / 2, enemyWidth, enemyHeight, maze, mazeWidth, mazeHeight, cellSize)) {
-        enemyPos[index].rx() = targetX;
-        enemyPos[index].ry() = targetY;
-        enemyPos[index].rx() = (enemyPos[index].x() / cellSize) * cellSize + cellSize / 2;
-        enemyPos[index].ry() = (enemyPos[index].y() / cellSize) * cellSize + cellSize / 2;
-    } else {
-        changeEnemyDirection(index);
+QSize MainWindow::viewSize() const {
+    // The whole maze if it fits in most of the screen, otherwise as many whole cells as do
+    QSize maze(game.maze.width() * cellSize, game.maze.height() * cellSize);
+    QScreen *screen = QGuiApplication::primaryScreen();
+    QSize available = screen ? screen->availableGeometry().size() * 0.9 : QSize(1280, 960);
+    return QSize(qMin(maze.width(), qMax(10, available.width() / cellSize) * cellSize),
+                 qMin(maze.height(), qMax(10, available.height() / cellSize) * cellSize));
+}
+
+bool MainWindow::updateCamera() {
+    QPointF center = pacmanRenderPosition();
+    QPoint next(qBound(0, qRound(center.x()) - width() / 2, game.maze.width() * cellSize - width()),
+                qBound(0, qRound(center.y()) - height() / 2, game.maze.height() * cellSize - height()));
+    bool moved = next != camera;
+    camera = next;
+    return moved;
+}
+
+QPointF MainWindow::renderPosition(int previousX, int previousY, int x, int y) const {
+    // Resets and respawns jump further than one cell per tick: show those without sliding
+    if (qAbs(x - previousX) > cellSize || qAbs(y - previousY) > cellSize)
+        return QPointF(x, y);
+    return QPointF(previousX + (x - previousX) * renderAlpha, previousY + (y - previousY) * renderAlpha);
+}
+
+QPointF MainWindow::pacmanRenderPosition() const {
+    return renderPosition(previousPacman.x, previousPacman.y, game.pacman.x, game.pacman.y);
+}
+
+QPointF MainWindow::enemyRenderPosition(int index) const {
+    if (index >= static_cast<int>(previousEnemyX.size()))
+        return QPointF(game.enemies.x[index], game.enemies.y[index]);
+    return renderPosition(previousEnemyX[index], previousEnemyY[index], game.enemies.x[index], game.enemies.y[index]);
+}
+
+QRegion MainWindow::spriteRegion() const {
+    // Sprites are at most 30 px wide; keep a pixel of margin for antialiasing
+    const qreal half = 16;
+    const QRectF visible = QRectF(QRect(camera, size())).adjusted(-half, -half, half, half);
+    QPointF center = pacmanRenderPosition();
+    QRegion region(QRectF(center.x() - half, center.y() - half, 2 * half, 2 * half).toAlignedRect());
+    for (int i = 0; i < game.enemyCount(); i++) {
+        center = enemyRenderPosition(i);
+        if (visible.contains(center))
+            region += QRectF(center.x() - half, center.y() - half, 2 * half, 2 * half).toAlignedRect();
     }
+    return region.translated(-camera);
 }
 
-void MainWindow::gameLoop() {
-    pacman->move(maze, mazeWidth, mazeHeight, cellSize);
-    for (int i = 0; i < enemyCount; i++) {
-        moveEnemy(i);
+QRect MainWindow::hudRect() const {
+    return QRect(0, 0, width(), cellSize + 8);
+}
+
+void MainWindow::setProfileOverlayVisible(bool visible) {
+    showProfile = visible;
+    updateProfileLines();
+    update();
+}
+
+void MainWindow::setTracePath(const QString &path) {
+    tracePath = path;
+}
+
+void MainWindow::setAutoplay(std::unique_ptr<InputPolicy> policy) {
+    autoplay = std::move(policy);
+}
+
+void MainWindow::updateProfileLines() {
+    profileLines.clear();
+    std::vector<PhaseStats> stats = profiler.stats();
+    for (int p = 0; p < static_cast<int>(ProfilePhase::Count); p++) {
+        profileLines << QString("%1  p50 %2 us  p99 %3 us")
+                            .arg(profilePhaseName(static_cast<ProfilePhase>(p)), -16)
+                            .arg(stats[p].p50Ns / 1000.0, 0, 'f', 1)
+                            .arg(stats[p].p99Ns / 1000.0, 0, 'f', 1);
+    }
+    lastProfileNs = clock.isValid() ? clock.nsecsElapsed() : 0;
+}
+
+QRect MainWindow::profileRect() const {
+    return QRect(6, cellSize + 8, 300, 16 * profileLines.size() + 8);
+}
+
+Input MainWindow::keyboardInput(qint64 tickEndNs) {
+    if (cancelHeldTurn) {
+        // Re-requesting the current heading replaces the buffered turn in the engine
+        cancelHeldTurn = false;
+        const PacmanState &state = game.pacman;
+        if (state.dx > 0) return Input::Right;
+        if (state.dx < 0) return Input::Left;
+        if (state.dy > 0) return Input::Down;
+        if (state.dy < 0) return Input::Up;
+        return Input::None;
     }
 
-    QRect pacmanRect(pacman->getX() - cellSize / 2, pacman->getY() - cellSize / 2, cellSize, cellSize);
-    QPoint pacmanCenter(pacman->getX(), pacman->getY());
+    qint64 pressedNs = 0;
+    Input input = inputQueue.take(tickEndNs, &pressedNs);
+    if (input != Input::None) {
+        heldTurn = input;
+        heldSinceNs = pressedNs;
+    }
+    return input;
+}
 
-    // Check collision with dots
-    for (int i = 0; i < dotPositions.size(); ++i) {
-        if (QLineF(pacmanCenter, dotPositions[i]).length() < cellSize / 2.0) {
-            int row = dotPositions[i].y() / cellSize;
-            int col = dotPositions[i].x() / cellSize;
-            if (row >= 0 && row < mazeHeight && col >= 0 && col < mazeWidth) {
-                maze[row][col] = MazeItem::Path;
-            }
-            dotPositions.remove(i);
-            score += 10;
+void MainWindow::trackHeldTurn(qint64 tickEndNs) {
+    if (heldTurn == Input::None)
+        return;
+
+    PacmanState requested = game.pacman;
+    requested.setDirection(heldTurn);
+    if (game.pacman.dx == requested.nextDx && game.pacman.dy == requested.nextDy) {
+        // Turn taken on this tick: time it until the frame showing it has been painted
+        latencyPressNs = heldSinceNs;
+        heldTurn = Input::None;
+    } else if (turnWindowNs > 0 && tickEndNs - heldSinceNs >= turnWindowNs) {
+        heldTurn = Input::None;
+        cancelHeldTurn = true;
+    }
+}
+
+bool MainWindow::startAudio(const QString &soundDirectory, std::unique_ptr<AudioBackend> backend, QString *error) {
+    std::string message;
+    if (!audio.loadSounds(soundDirectory.toStdString(), &message) || !audio.start(std::move(backend), &message)) {
+        if (error)
+            *error = QString::fromStdString(message);
+        return false;
+    }
+    return true;
+}
+
+bool MainWindow::renderOffscreen(FrameWriter &writer, int framesPerTick, qint64 maxTicks, QString *error) {
+    timer->stop(); // Ticks come from this loop, not the frame timer
+    fastReplay = false;
+    framesPerTick = qMax(1, framesPerTick);
+
+    // The encoder threads keep a reference to each frame, so every frame gets its own image
+    auto emitFrame = [this, &writer](qreal alpha) {
+        renderAlpha = alpha;
+        updateCamera();
+        QImage frame(size(), QImage::Format_RGB32);
+        render(&frame);
+        writer.push(frame);
+    };
+
+    emitFrame(1.0);
+    QRegion dirty; // Unused: every frame is painted in full
+    bool hudChanged = false;
+    for (qint64 tick = 0; maxTicks <= 0 || tick < maxTicks; tick++) {
+        if (game.isOver() || (replaying && replayPlayer.atEnd(game)))
             break;
+        simulateTick(dirty, hudChanged, 0);
+        for (int f = 1; f <= framesPerTick; f++) {
+            emitFrame(static_cast<qreal>(f) / framesPerTick);
         }
     }
 
-    // Check collision with power pellets
-    for (int i = 0; i < powerPellets.size(); ++i) {
-        if (QLineF(pacmanCenter, powerPellets[i]).length() < cellSize / 2.0) {
-            int row = powerPellets[i].y() / cellSize;
-            int col = powerPellets[i].x() / cellSize;
-            if (row >= 0 && row < mazeHeight && col >= 0 && col < mazeWidth) {
-                maze[row][col] = MazeItem::Path;
-            }
-            powerPellets.remove(i);
-            score += 50;
-            startPowerUp();
-            break;
+    if (replaying && replayPlayer.atEnd(game)) {
+        finishReplay();
+    } else {
+        finishRecording();
+    }
+    return writer.close(error);
+}
+
+void MainWindow::setTurnWindow(int ms) {
+    turnWindowNs = qMax(0, ms) * 1000000LL;
+}
+
+bool MainWindow::simulateTick(QRegion &dirty, bool &hudChanged, qint64 tickEndNs) {
+    int oldScore = game.score;
+    int oldLives = game.lives;
+    previousPacman = game.pacman;
+    previousEnemyX = game.enemies.x;
+    previousEnemyY = game.enemies.y;
+
+    Input input = Input::None;
+    if (replaying) {
+        input = replayPlayer.inputFor(game);
+    } else {
+        input = keyboardInput(tickEndNs);
+        if (autoplay && input == Input::None && heldTurn == Input::None) {
+            input = autoplay->decide(game);
         }
     }
+    recorder.record(game, input);
+    game.step(input);
+    if (!replaying) {
+        trackHeldTurn(tickEndNs);
+    }
+    if (!fastReplay) {
+        audio.playEvents(game.events); // Only queues the sounds; the mixer thread does the rest
+    }
+    pacman->setState(game.pacman);
+    const bool pacmanMoved = game.pacman.x != previousPacman.x || game.pacman.y != previousPacman.y;
+    if (pacmanMoved) {
+        pacman->advanceAnimation(); // The mouth stays still while Pacman is stopped against a wall
+    }
+    spritesMoving = pacmanMoved || game.enemies.x != previousEnemyX || game.enemies.y != previousEnemyY;
 
-    for (int i = 0; i < enemyCount; i++) {
-        QRect enemyRect(enemyPos[i].x() - 15, enemyPos[i].y() - 15, 30, 30);
-        if (pacmanRect.intersects(enemyRect)) {
-            if (powerUpActive) {
-                enemyPos[i].setX(cellSize * 10 + cellSize / 2);
-                enemyPos[i].setY(cellSize * 10 + cellSize / 2);
-                changeEnemyDirection(i);
-            } else {
-                lives--;
-                if (lives <= 0) {
-                    timer->stop();
-                    gameEnded = true;
-                } else {
-                    resetPositions();
-                }
-                break;
-            }
+    if (game.eatenRow >= 0) {
+        eraseCell(game.eatenRow, game.eatenCol);
+        dirty += QRect(game.eatenCol * cellSize - camera.x(), game.eatenRow * cellSize - camera.y(), cellSize, cellSize);
+    }
+    const bool scoreChanged = game.score != oldScore || game.lives != oldLives;
+    if (scoreChanged) {
+        hudChanged = true;
+    }
+    return spritesMoving || scoreChanged || game.eatenRow >= 0;
+}
+
+void MainWindow::gameLoop() {
+    qint64 now = clock.nsecsElapsed();
+    // After a stall, drop the excess time instead of fast-forwarding through it
+    accumulatorNs = qMin(accumulatorNs + now - lastFrameNs, maxCatchUpTicks * tickNs);
+    lastFrameNs = now;
+
+    QRegion dirty = lastSpriteRegion;
+    bool hudChanged = false;
+    bool sceneChanged = spritesMoving; // Sprites are still sliding towards where the last tick put them
+    if (fastReplay) {
+        // Maximum speed: run the whole stream now and only paint the final frame
+        while (!replayPlayer.atEnd(game)) {
+            sceneChanged |= simulateTick(dirty, hudChanged, now);
         }
     }
-    update();
+    while (accumulatorNs >= tickNs && !game.isOver() && !(replaying && replayPlayer.atEnd(game))) {
+        accumulatorNs -= tickNs;
+        sceneChanged |= simulateTick(dirty, hudChanged, now - accumulatorNs); // Simulated time reached by this tick
+    }
+
+    if (replaying && replayPlayer.atEnd(game)) {
+        finishReplay();
+        return;
+    }
+    if (game.isOver()) {
+        finishRecording();
+        stopLoop();
+        renderAlpha = 1.0;
+        updateCamera();
+        update();
+        return;
+    }
+
+    renderAlpha = static_cast<qreal>(accumulatorNs) / tickNs;
+    scheduleNextFrame();
+    const bool profileDue = showProfile && now - lastProfileNs >= profileRefreshMs * 1000000LL;
+    if (!sceneChanged) {
+        // Nothing moved, was eaten or scored since the last frame: only the overlay can need a repaint
+        if (profileDue) {
+            updateProfileLines();
+            update(profileRect());
+        }
+        return;
+    }
+    // A moving view shifts everything on screen, so it needs a full repaint
+    if (updateCamera() || game.enemyCount() > maxDirtySprites) {
+        lastSpriteRegion = QRegion();
+        update();
+        return;
+    }
+
+    if (hudChanged) {
+        dirty += hudRect();
+    }
+    if (profileDue) {
+        updateProfileLines();
+        dirty += profileRect();
+    }
+    lastSpriteRegion = spriteRegion();
+    dirty += lastSpriteRegion;
+    update(dirty);
 }
 
-void MainWindow::paintEvent(QPaintEvent *) {
+void MainWindow::paintEvent(QPaintEvent *event) {
     QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing);
-    painter.fillRect(rect(), Qt::black);
-
-    // Draw maze
-    for (int i = 0; i < mazeHeight; ++i) {
-        for (int j = 0; j < mazeWidth; ++j) {
-            QRect cellRect(j * cellSize, i * cellSize, cellSize, cellSize);
-            if (maze[i][j] == MazeItem::Wall) {
-                painter.fillRect(cellRect, Qt::blue);
-            } else if (maze[i][j] == MazeItem::Dot) {
-                painter.setBrush(Qt::yellow);
-                painter.drawEllipse(getCellCenter(i, j), 3, 3);
-            } else if (maze[i][j] == MazeItem::PowerPellet) {
-                painter.setBrush(Qt::white);
-                painter.drawEllipse(getCellCenter(i, j), 7, 7);
+    painter.setClipRegion(event->region());
+    paintCount++;
+    const QRect area = event->rect().translated(camera); // Repainted part of the maze, in maze pixels
+    {
+        ScopedTimer timer(&profiler, ProfilePhase::PaintMaze);
+        // Only the chunks under the repainted area
+        const int lastChunkRow = qMin(area.bottom(), game.maze.height() * cellSize - 1) / chunkPixels;
+        const int lastChunkCol = qMin(area.right(), game.maze.width() * cellSize - 1) / chunkPixels;
+        for (int chunkRow = qMax(0, area.top()) / chunkPixels; chunkRow <= lastChunkRow; chunkRow++) {
+            for (int chunkCol = qMax(0, area.left()) / chunkPixels; chunkCol <= lastChunkCol; chunkCol++) {
+                painter.drawPixmap(QPoint(chunkCol * chunkPixels, chunkRow * chunkPixels) - camera,
+                                   mazeChunk(chunkRow, chunkCol));
             }
         }
     }
 
-    pacman->draw(&painter, cellSize);
-
-    // Draw enemies
-    for (int i = 0; i < enemyCount; i++) {
-        QPixmap enemyPixmap(":/images/enemy.png");
-        QColor enemyColor = powerUpActive ? Qt::blue : enemyColors[i];
-        if (enemyPixmap.isNull()) {
-            painter.setBrush(enemyColor);
-            painter.drawEllipse(enemyPos[i], 10, 10);
-        } else {
-            painter.drawPixmap(enemyPos[i].x() - 15, enemyPos[i].y() - 15,
-                               enemyPixmap.scaled(30, 30, Qt::KeepAspectRatio, Qt::SmoothTransformation));
+    {
+        ScopedTimer timer(&profiler, ProfilePhase::PaintSprites);
+        painter.translate(-camera); // Sprites are placed in maze pixels
+        pacman->draw(&painter, sprites, cellSize, pacmanRenderPosition());
+
+        // Draw the enemies that overlap the repainted area
+        const qreal half = SpriteCache::enemySize / 2.0;
+        const QRectF visible = QRectF(area).adjusted(-half, -half, half, half);
+        for (int i = 0; i < game.enemyCount(); i++) {
+            QPointF center = enemyRenderPosition(i);
+            if (!visible.contains(center))
+                continue;
+            painter.drawPixmap(QPointF(center.x() - half, center.y() - half),
+                               sprites.enemy(i, game.powerUpActive));
         }
+        painter.resetTransform();
     }
 
+    ScopedTimer timer(&profiler, ProfilePhase::PaintHud);
     // Draw score and lives
     painter.setPen(Qt::white);
     painter.setFont(QFont("Arial", 14));
-    painter.drawText(10, 20, QString("Score: %1").arg(score));
-    painter.drawText(width() - 100, 20, QString("Lives: %1").arg(lives));
+    painter.drawText(10, 20, QString("Score: %1").arg(game.score));
+    painter.drawText(width() - 100, 20, QString("Lives: %1").arg(game.lives));
+
+    if (showProfile) {
+        QRect box = profileRect();
+        painter.fillRect(box, QColor(0, 0, 0, 180));
+        painter.setFont(QFont("Monospace", 9));
+        for (int i = 0; i < profileLines.size(); i++) {
+            painter.drawText(box.left() + 4, box.top() + 16 * (i + 1), profileLines[i]);
+        }
+    }
 
-    if (gameEnded) {
+    if (game.gameEnded) {
         painter.setPen(Qt::red);
         painter.setFont(QFont("Arial", 24, QFont::Bold));
         painter.drawText(rect(), Qt::AlignCenter, "GAME OVER!");
         tryAgainButton->show();
-    } else if (!timer->isActive() && dotPositions.isEmpty() && powerPellets.isEmpty()) {
+    } else if (game.won) {
         painter.setPen(Qt::green);
         painter.setFont(QFont("Arial", 24, QFont::Bold));
         painter.drawText(rect(), Qt::AlignCenter, "YOU WIN!");
+    } else if (paused) {
+        painter.setPen(Qt::yellow);
+        painter.setFont(QFont("Arial", 24, QFont::Bold));
+        painter.drawText(rect(), Qt::AlignCenter, "PAUSED");
     }
-}
 
-void MainWindow::startPowerUp() {
-    powerUpActive = true;
-    pacman->setSpeed(originalPacmanSpeed * 2);
-    powerUpTimer->start(10000);
-}
-
-void MainWindow::endPowerUp() {
-    powerUpActive = false;
-    pacman->setSpeed(originalPacmanSpeed);
-    powerUpTimer->stop();
+    if (latencyPressNs >= 0) {
+        // The turn is in this frame: record press-to-paint on the profiler's clock
+        qint64 sincePress = clock.nsecsElapsed() - latencyPressNs;
+        uint64_t paintedNs = profiler.now();
+        profiler.record(ProfilePhase::InputToPhoton, paintedNs - qMin<uint64_t>(paintedNs, sincePress), paintedNs);
+        latencyPressNs = -1;
+    }
 }
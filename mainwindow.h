@@ -6,65 +6,138 @@
 #include <QVector>
 #include <QPoint>
 #include "pacman.h"
+#include "gamestate.h"
+#include "spritecache.h"
+#include "replay.h"
+#include "profiler.h"
+#include "inputpolicy.h"
+#include "inputqueue.h"
+#include "audio.h"
+#include "framewriter.h"
 #include <QPushButton>
-
-// Define different types of maze elements
-enum class MazeItem {
-    Wall,
-    Path,
-    Dot,
-    PowerPellet
-};
+#include <QPixmap>
+#include <QRegion>
+#include <QHash>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <memory>
+#include <vector>
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
 
 public:
-    MainWindow(QWidget *parent = nullptr);
+    MainWindow(const Level &level = defaultLevel(), int enemyCount = GameState::defaultEnemyCount,
+               GhostPolicy ghostPolicy = GhostPolicy::Random, int tickRate = GameState::defaultTickRate,
+               QWidget *parent = nullptr);
     ~MainWindow();
 
+    void recordTo(const QString &path); // Save each game played from now on as a replay (the latest game wins)
+    bool playReplay(const QString &path, bool fast, QString *error = nullptr); // fast = max speed, no rendering
+    void setProfileOverlayVisible(bool visible); // Per-phase p50/p99 timings under the HUD (toggled with F3)
+    void setTracePath(const QString &path); // Write a Chrome trace of the recent timings there on exit
+    void setAutoplay(std::unique_ptr<InputPolicy> policy); // Let a policy steer whenever no key was pressed
+    void setGhostSeparation(bool enabled) { game.ghostSeparation = enabled; } // Call before recordTo
+    void setActiveRadius(int chunks) { game.activeRadius = qMax(0, chunks); } // Call before recordTo
+    int tickRate() const { return game.getTickRate(); } // Simulation steps per second
+    void setTurnWindow(int ms); // How long a turn that cannot be taken yet stays buffered (0 = until taken)
+    void setPaused(bool pause); // Freeze the game (P toggles); nothing wakes up until it resumes
+    bool startAudio(const QString &soundDirectory, std::unique_ptr<AudioBackend> backend, QString *error = nullptr); // Play sound effects there
+    // Headless: step the game (replay, bot or idle) without showing the window and hand every frame to
+    // 'writer'; framesPerTick > 1 adds interpolated in-between frames. Stops at game over, the end of
+    // the replay or maxTicks (0 = no limit)
+    bool renderOffscreen(FrameWriter &writer, int framesPerTick, qint64 maxTicks, QString *error = nullptr);
+
 protected:
     void keyPressEvent(QKeyEvent *event) override; // Handles keyboard input
     void paintEvent(QPaintEvent *event) override; // Responsible for drawing the game screen
 
 private slots:
-    void gameLoop(); // Runs every tick to update game logic
-   // void endPowerUp();
+    void gameLoop(); // Fixed-timestep simulation, then a repaint of whatever changed; see scheduleNextFrame
     void resetGame(); // Function to reset the game
 private:
     Pacman *pacman; // Pacman character instance
-    QTimer *timer; // Timer to control game updates
-    int score; // Player score
-    // QVector<QPoint> pellets; // No longer directly storing pellet positions
-    QVector<QPoint> powerPellets; // Store power pellet positions
-    QVector<QPoint> dotPositions; // Store remaining dot positions
-    // This NEW ADDED CODE
-    int lives; // Track remaining lives
-    bool gameEnded; // Track if game has ended
+    QTimer *timer; // The only timer: drives simulation, animation and repaints, stopped while nothing can change
+    // Fixed-timestep accumulator: the simulation advances in whole ticks, rendering interpolates between them
+    QElapsedTimer clock;
+    int frameInterval; // Milliseconds between frames
+    qint64 tickNs; // Simulation tick length
+    qint64 lastFrameNs;
+    qint64 accumulatorNs; // Time not yet simulated
+    qreal renderAlpha; // Fraction of the next tick already elapsed
+    static const int maxCatchUpTicks = 5; // Ticks simulated per frame at most after a stall
+    PacmanState previousPacman; // State before the last tick, interpolated from
+    std::vector<int> previousEnemyX, previousEnemyY;
+    bool spritesMoving; // The last tick moved a sprite, so frames between ticks differ
+    bool paused;
+    QRegion lastSpriteRegion; // Where sprites were drawn last frame
+    // Replays: the recorder captures inputs as they are fed to step(), the player feeds them back
+    ReplayRecorder recorder;
+    QString recordPath;
+    ReplayPlayer replayPlayer;
+    bool replaying;
+    bool fastReplay;
+    void finishRecording();
+    void finishReplay();
+    void restartView(); // Rebuild the maze layer and restart the frame loop after the game changed
+    GameState game; // Headless simulation: maze, pellets, enemies, score and lives
+    // Timestamped key presses: each is applied by the tick whose time span contains it, then
+    // held until Pacman takes the turn or the turn window runs out
+    InputQueue inputQueue;
+    Input heldTurn; // Requested turn not taken yet
+    qint64 heldSinceNs; // When heldTurn was pressed
+    qint64 turnWindowNs;
+    bool cancelHeldTurn; // Window ran out: tell the engine to drop the buffered turn next tick
+    qint64 latencyPressNs; // Press whose turn was taken but not painted yet, -1 if none
+    std::unique_ptr<InputPolicy> autoplay; // Optional bot; key presses still take precedence
+    AudioEngine audio; // Sound effects for the step events, mixed on their own thread (silent until startAudio)
     QPushButton *tryAgainButton; // Button to restart game
-    bool powerUpActive;
-    QTimer *powerUpTimer;
-    int originalPacmanSpeed;
-    QColor originalEnemyColor; // Store original enemy color
-    void startPowerUp();
-    void endPowerUp();
-    // THE NEW ADDED CODE ENDS HERE
-    static const int mazeWidth = 20; // Width of the maze in cells
-    static const int mazeHeight = 20; // Height of the maze in cells
-    static const int cellSize = 20; // Size of each cell in pixels
-    MazeItem maze[mazeHeight][mazeWidth]; // 2D array to represent the maze
-    void initializeMaze(); // Initialize the maze layout
-    // void initializePellets(); // No longer used directly
-    // Enemy logic
-    static const int enemyCount = 3; // Number of enemies
-    QPoint enemyPos[enemyCount]; // Current position of the enemy
-    int enemyDx[enemyCount];
-    int enemyDy[enemyCount]; // Direction of enemy movement
-    QColor enemyColors[enemyCount]; // Colors for enemies
-    void moveEnemy(int index); // Update specific enemy position
-    void changeEnemyDirection(int index); // Change direction for specific enemy
+    static const int cellSize = GameState::cellSize; // Size of each cell in pixels
+    static const int maxDirtySprites = 256; // Above this many sprites a full repaint beats a huge QRegion
+    QVector<QColor> enemyColors; // Palette cycled over the enemy pool
+    SpriteCache sprites; // Pacman and enemy frames, built once at startup
     QPoint getCellCenter(int row, int col) const; // Helper to get the center of a cell
-    void resetPositions();
+    // Static maze layer in chunks of mazeTileSize x mazeTileSize cells: each is drawn the first time it
+    // comes into view and patched when a pellet is eaten; beyond maxCachedChunks, the chunks unused
+    // for longest are dropped, so memory follows the window size rather than the maze size
+    struct MazeChunk {
+        QPixmap pixmap;
+        quint64 lastUsed; // paintCount of the last paint that drew it
+    };
+    static const int chunkPixels = mazeTileSize * cellSize;
+    QHash<int, MazeChunk> mazeChunks; // Keyed by chunk row * chunksPerRow + chunk column
+    int maxCachedChunks;
+    quint64 paintCount;
+    void renderMazeLayer(); // Drop every cached chunk, e.g. after the maze was rebuilt
+    const QPixmap &mazeChunk(int chunkRow, int chunkCol);
+    void eraseCell(int row, int col);
+    // Camera: the window shows the whole maze when it fits on the screen, otherwise a view that
+    // follows Pacman; camera is the view's top-left corner in maze pixels
+    QPoint camera;
+    QSize viewSize() const;
+    bool updateCamera(); // Center on Pacman's render position; true if the view moved
+    void startLoop();
+    void stopLoop(); // Paused or over: no timer, and the mixer sleeps once the last sound ends
+    // Wake every display frame while sprites are moving; otherwise nothing changes on screen
+    // before the next tick, so sleep until it is due
+    void scheduleNextFrame();
+    bool simulateTick(QRegion &dirty, bool &hudChanged, qint64 tickEndNs); // True if anything on screen changed
+    Input keyboardInput(qint64 tickEndNs); // Input for the tick ending at tickEndNs
+    void trackHeldTurn(qint64 tickEndNs); // After a step: was the held turn taken, or did it expire?
+    QPointF renderPosition(int previousX, int previousY, int x, int y) const;
+    QPointF pacmanRenderPosition() const;
+    QPointF enemyRenderPosition(int index) const;
+    QRegion spriteRegion() const; // Window area covered by Pacman and the visible enemies at their interpolated positions
+    QRect hudRect() const; // Area covered by the score and lives text
+    // Instrumentation: the engine and paintEvent record phase timings, the overlay summarizes them
+    Profiler profiler;
+    bool showProfile;
+    QStringList profileLines;
+    qint64 lastProfileNs; // When profileLines were last refreshed
+    QString tracePath;
+    static const int profileRefreshMs = 250;
+    void updateProfileLines();
+    QRect profileRect() const;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,224 @@
+#include "maze.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include "builtinlevels.h"
+
+namespace {
+
+const char binaryMagic[4] = {'P', 'M', 'Z', '1'};
+
+uint32_t readU32(const unsigned char *bytes) {
+    return uint32_t(bytes[0]) | uint32_t(bytes[1]) << 8 | uint32_t(bytes[2]) << 16 | uint32_t(bytes[3]) << 24;
+}
+
+void writeU32(std::ostream &out, uint32_t value) {
+    char bytes[4] = {char(value & 0xff), char((value >> 8) & 0xff), char((value >> 16) & 0xff), char((value >> 24) & 0xff)};
+    out.write(bytes, 4);
+}
+
+bool fail(std::string *error, const std::string &message) {
+    if (error)
+        *error = message;
+    return false;
+}
+
+} // namespace
+
+Maze::Maze()
+    : w(0), h(0), tilesPerRow(0), exitMask(std::make_shared<std::vector<uint8_t>>())
+{
+}
+
+Maze::Maze(int width, int height, MazeItem fill)
+    : w(width), h(height), tilesPerRow((width + mazeTileMask) >> mazeTileShift),
+    exitMask(std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(width) * height, 0))
+{
+    // Every tile starts out as the same shared block; writes give each tile its own copy
+    auto blank = std::make_shared<MazeTile>();
+    std::fill(std::begin(blank->cells), std::end(blank->cells), fill);
+    tiles.assign(static_cast<size_t>(tilesPerRow) * ((height + mazeTileMask) >> mazeTileShift), blank);
+
+    if (fill != MazeItem::Wall) {
+        for (int i = 0; i < h; ++i) {
+            for (int j = 0; j < w; ++j) {
+                updateExits(i, j);
+            }
+        }
+    }
+}
+
+Maze::Maze(int width, int height, const MazeItem *cells, const uint8_t *exits)
+    : w(width), h(height), tilesPerRow((width + mazeTileMask) >> mazeTileShift),
+    exitMask(std::make_shared<std::vector<uint8_t>>(exits, exits + static_cast<size_t>(width) * height))
+{
+    const int tileRows = (height + mazeTileMask) >> mazeTileShift;
+    tiles.resize(static_cast<size_t>(tilesPerRow) * tileRows);
+    for (int tileRow = 0; tileRow < tileRows; tileRow++) {
+        for (int tileCol = 0; tileCol < tilesPerRow; tileCol++) {
+            auto tile = std::make_shared<MazeTile>();
+            std::fill(std::begin(tile->cells), std::end(tile->cells), MazeItem::Wall); // Past the maze edge
+            const int firstRow = tileRow << mazeTileShift;
+            const int firstCol = tileCol << mazeTileShift;
+            const int rows = std::min(mazeTileSize, height - firstRow);
+            const int cols = std::min(mazeTileSize, width - firstCol);
+            for (int r = 0; r < rows; r++) {
+                std::copy(cells + static_cast<size_t>(firstRow + r) * width + firstCol,
+                          cells + static_cast<size_t>(firstRow + r) * width + firstCol + cols,
+                          tile->cells + (r << mazeTileShift));
+            }
+            tiles[static_cast<size_t>(tileRow) * tilesPerRow + tileCol] = tile;
+        }
+    }
+}
+
+void Maze::set(int row, int col, MazeItem item) {
+    std::shared_ptr<MazeTile> &tile = tiles[(row >> mazeTileShift) * tilesPerRow + (col >> mazeTileShift)];
+    const int offset = (row & mazeTileMask) << mazeTileShift | (col & mazeTileMask);
+    MazeItem old = tile->cells[offset];
+    if (old == item)
+        return;
+    if (tile.use_count() > 1) {
+        if (spareTiles.tiles.empty()) {
+            tile = std::make_shared<MazeTile>(*tile);
+        } else {
+            std::shared_ptr<MazeTile> copy = std::move(spareTiles.tiles.back());
+            spareTiles.tiles.pop_back();
+            *copy = *tile;
+            tile = std::move(copy);
+        }
+    }
+    tile->cells[offset] = item;
+
+    if ((old == MazeItem::Wall) == (item == MazeItem::Wall))
+        return; // Eating pellets never changes passability
+
+    if (exitMask.use_count() > 1) {
+        exitMask = std::make_shared<std::vector<uint8_t>>(*exitMask);
+    }
+    updateExits(row, col);
+    if (col + 1 < w) updateExits(row, col + 1);
+    if (col > 0) updateExits(row, col - 1);
+    if (row + 1 < h) updateExits(row + 1, col);
+    if (row > 0) updateExits(row - 1, col);
+}
+
+int Maze::sharedTiles(const Maze &other) const {
+    if (tiles.size() != other.tiles.size())
+        return 0;
+    int shared = 0;
+    for (size_t i = 0; i < tiles.size(); i++) {
+        shared += tiles[i] == other.tiles[i];
+    }
+    return shared;
+}
+
+void Maze::restore(const Maze &other) {
+    if (tiles.size() == other.tiles.size()) {
+        for (size_t i = 0; i < tiles.size(); i++) {
+            if (tiles[i] != other.tiles[i] && tiles[i].use_count() == 1)
+                spareTiles.tiles.push_back(std::move(tiles[i]));
+            tiles[i] = other.tiles[i];
+        }
+    } else {
+        tiles = other.tiles;
+    }
+    w = other.w;
+    h = other.h;
+    tilesPerRow = other.tilesPerRow;
+    exitMask = other.exitMask;
+}
+
+void Maze::updateExits(int row, int col) {
+    uint8_t mask = 0;
+    if (col + 1 < w && at(row, col + 1) != MazeItem::Wall) mask |= ExitRight;
+    if (col > 0 && at(row, col - 1) != MazeItem::Wall) mask |= ExitLeft;
+    if (row + 1 < h && at(row + 1, col) != MazeItem::Wall) mask |= ExitDown;
+    if (row > 0 && at(row - 1, col) != MazeItem::Wall) mask |= ExitUp;
+    (*exitMask)[static_cast<size_t>(row) * w + col] = mask;
+}
+
+Level defaultLevel() {
+    return builtin::toLevel(builtin::classic);
+}
+
+bool parseLevel(const std::string &text, Level &level, std::string *error) {
+    std::istringstream in(text);
+    std::string line;
+    std::vector<char> cells;
+    int width = 0;
+    int height = 0;
+
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty())
+            continue;
+        if (width == 0) {
+            width = static_cast<int>(line.size());
+        } else if (static_cast<int>(line.size()) != width) {
+            return fail(error, "row " + std::to_string(height + 1) + " has " + std::to_string(line.size())
+                               + " cells, expected " + std::to_string(width));
+        }
+        cells.insert(cells.end(), line.begin(), line.end());
+        height++;
+    }
+
+    if (width == 0 || height == 0)
+        return fail(error, "level is empty");
+    if (!isSupportedLevelSize(width, height))
+        return fail(error, "level is too large");
+    if (std::find(cells.begin(), cells.end(), 'S') == cells.end())
+        return fail(error, "level has no Pacman spawn ('S')");
+
+    level.width = width;
+    level.height = height;
+    level.cells = std::move(cells);
+    return true;
+}
+
+bool loadLevelFile(const std::string &path, Level &level, std::string *error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return fail(error, "cannot open " + path);
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if (data.size() < 4 || std::memcmp(data.data(), binaryMagic, 4) != 0)
+        return parseLevel(data, level, error);
+
+    if (data.size() < 12)
+        return fail(error, "truncated binary level header");
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data.data());
+    uint32_t width = readU32(bytes + 4);
+    uint32_t height = readU32(bytes + 8);
+    if (!isSupportedLevelSize(width, height) || data.size() - 12 != static_cast<size_t>(width) * height)
+        return fail(error, "binary level size does not match its header");
+    if (std::find(data.begin() + 12, data.end(), 'S') == data.end())
+        return fail(error, "level has no Pacman spawn ('S')");
+
+    level.width = static_cast<int>(width);
+    level.height = static_cast<int>(height);
+    level.cells.assign(data.begin() + 12, data.end());
+    return true;
+}
+
+bool saveLevelFile(const std::string &path, const Level &level, bool binary) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    if (binary) {
+        file.write(binaryMagic, 4);
+        writeU32(file, static_cast<uint32_t>(level.width));
+        writeU32(file, static_cast<uint32_t>(level.height));
+        file.write(level.cells.data(), static_cast<std::streamsize>(level.cells.size()));
+    } else {
+        for (int i = 0; i < level.height; ++i) {
+            file.write(&level.cells[static_cast<size_t>(i) * level.width], level.width);
+            file.put('\n');
+        }
+    }
+    return static_cast<bool>(file);
+}
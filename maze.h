@@ -0,0 +1,115 @@
+#ifndef MAZE_H
+#define MAZE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Define different types of maze elements
+enum class MazeItem : uint8_t {
+    Wall,
+    Path,
+    Dot,
+    PowerPellet
+};
+
+// Exit bits: which of a cell's four neighbors can be entered (in bounds and not a wall)
+enum ExitBits : uint8_t {
+    ExitRight = 1,
+    ExitLeft = 2,
+    ExitDown = 4,
+    ExitUp = 8
+};
+
+// Cells live in square tiles that copies of a maze share. Copying a maze copies one pointer per
+// tile, and the first write to a shared tile clones only that tile (copy-on-write), so a snapshot
+// costs the tiles that changed after it was taken
+const int mazeTileShift = 5; // 32x32 cells per tile
+const int mazeTileSize = 1 << mazeTileShift;
+const int mazeTileMask = mazeTileSize - 1;
+
+struct MazeTile {
+    MazeItem cells[mazeTileSize * mazeTileSize];
+};
+
+// Non-owning width/height view over a maze, shared by the engine and the Pacman widget
+struct MazeView {
+    const std::shared_ptr<MazeTile> *tiles;
+    const uint8_t *exitMask; // Row-major, one entry per cell
+    int width;
+    int height;
+    int tilesPerRow;
+
+    MazeItem at(int row, int col) const {
+        return tiles[(row >> mazeTileShift) * tilesPerRow + (col >> mazeTileShift)]
+            ->cells[(row & mazeTileMask) << mazeTileShift | (col & mazeTileMask)];
+    }
+    uint8_t exits(int row, int col) const { return exitMask[static_cast<size_t>(row) * width + col]; }
+    bool contains(int row, int col) const { return row >= 0 && row < height && col >= 0 && col < width; }
+};
+
+// Maze grid of any size. Walls only change while a level is built, so the exit masks stay one
+// flat array (shared between copies as well); pellets are eaten from the copy-on-write tiles
+class Maze {
+public:
+    Maze();
+    Maze(int width, int height, MazeItem fill = MazeItem::Wall);
+    // From row-major cells and their exit masks, e.g. a compiled level table, without recomputing them
+    Maze(int width, int height, const MazeItem *cells, const uint8_t *exits);
+
+    int width() const { return w; }
+    int height() const { return h; }
+    bool contains(int row, int col) const { return row >= 0 && row < h && col >= 0 && col < w; }
+    MazeItem at(int row, int col) const { return view().at(row, col); }
+    uint8_t exits(int row, int col) const { return (*exitMask)[static_cast<size_t>(row) * w + col]; }
+    void set(int row, int col, MazeItem item); // Keeps the exit mask of the cell and its neighbors in sync
+    MazeView view() const { return MazeView{tiles.data(), exitMask->data(), w, h, tilesPerRow}; }
+    int sharedTiles(const Maze &other) const; // Tiles both mazes still share, to check snapshot costs
+    // Like assignment, but keeps the tiles only this maze held for later writes to reuse, so a
+    // maze that is restored and written over and over stops allocating
+    void restore(const Maze &other);
+
+private:
+    // Tiles dropped by restore(), none of them shared. Copies of a maze start with an empty pool
+    struct TilePool {
+        std::vector<std::shared_ptr<MazeTile>> tiles;
+        TilePool() = default;
+        TilePool(const TilePool &) {}
+        TilePool &operator=(const TilePool &) { return *this; }
+    };
+
+    int w, h;
+    int tilesPerRow;
+    std::vector<std::shared_ptr<MazeTile>> tiles;
+    std::shared_ptr<std::vector<uint8_t>> exitMask; // ExitBits per cell, so movement checks are a single byte lookup
+    TilePool spareTiles;
+
+    void updateExits(int row, int col);
+};
+
+// Level layout in the maze cell vocabulary:
+// W = wall, D = dot, N = power pellet, S = Pacman spawn, E = enemy spawn, anything else = empty path
+struct Level {
+    int width = 0;
+    int height = 0;
+    std::vector<char> cells; // Row-major, width * height characters
+
+    char at(int row, int col) const { return cells[static_cast<size_t>(row) * width + col]; }
+};
+
+// Cell indices are ints in the flow fields and the bots, so levels stay below 2^31 cells
+inline bool isSupportedLevelSize(uint64_t width, uint64_t height) {
+    return width > 0 && height > 0 && width <= 100000 && height <= 100000 && width * height <= 0x7fffffffULL;
+}
+
+Level defaultLevel(); // The built-in 20x20 level, copied from its compiled table (builtinlevels.h)
+
+// Text levels are one row per line; binary levels start with "PMZ1", then
+// little-endian uint32 width and height, then one cell character per byte. Both are rejected
+// without an 'S' cell
+bool parseLevel(const std::string &text, Level &level, std::string *error = nullptr);
+bool loadLevelFile(const std::string &path, Level &level, std::string *error = nullptr);
+bool saveLevelFile(const std::string &path, const Level &level, bool binary = false);
+
+#endif // MAZE_H
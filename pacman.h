@@ -3,11 +3,10 @@
 
 #include <QWidget>
 #include <QPainter>
-#include <QTimer>
 #include <QRectF>
 #include <QtMath>
-
-enum class MazeItem;
+#include "gamestate.h"
+#include "spritecache.h"
 
 class Pacman : public QWidget {
     Q_OBJECT
@@ -15,26 +14,23 @@ public:
     explicit Pacman(QWidget *parent = nullptr);
     ~Pacman();
 
-    void move(const MazeItem maze[][20], int mazeWidth, int mazeHeight, int cellSize);
-    void draw(QPainter *painter, int cellSize);
+    void move(const MazeView &maze, int cellSize);
+    void draw(QPainter *painter, const SpriteCache &sprites, int cellSize, const QPointF &center); // Center may be interpolated
+    void advanceAnimation(); // Open/close the mouth one step, called once per simulation tick
     void setDirection(int key);
     void setNextDirection(int key);
-    int getX() const { return x; }
-    int getY() const { return y; }
-    void setX(int newX) { x = newX; }
-    void setY(int newY) { y = newY; }
-    void setSpeed(int newSpeed) { speed = newSpeed; }
+    static Input inputFromKey(int key); // Map a Qt arrow key to an engine input
+    int getX() const { return state.x; }
+    int getY() const { return state.y; }
+    void setX(int newX) { state.x = newX; }
+    void setY(int newY) { state.y = newY; }
+    void setSpeed(int newSpeed) { state.speed = newSpeed; }
+    void setState(const PacmanState &newState) { state = newState; } // Sync with the engine after a step
 
 private:
-    int x, y;
-    int dx, dy;
-    int nextDx, nextDy;
-    int speed;
+    PacmanState state; // Position and direction, moved by the engine
     int mouthAngle;
     bool mouthOpening;
-    QTimer *animationTimer;
-
-    bool checkWallCollision(int targetX, int targetY, const MazeItem maze[][20], int mazeWidth, int mazeHeight, int cellSize) const;
 };
 
 #endif // PACMAN_H
@@ -0,0 +1,48 @@
+// paintbench.cpp - full-window paintEvent into an offscreen QImage (Google Benchmark)
+// Runs on the offscreen platform plugin unless QT_QPA_PLATFORM is already set
+#include <benchmark/benchmark.h>
+#include <QApplication>
+#include <QImage>
+#include <QPainter>
+#include "mainwindow.h"
+#include "benchlevel.h"
+
+namespace {
+
+// Mazes larger than the screen are shown through a view that follows Pacman, so the frame
+// cost should stay flat from 200x200 upwards
+void paintArgs(benchmark::internal::Benchmark *bench) {
+    for (int size : {20, 200, 2000}) {
+        for (int enemies : {3, 100, 1000, 10000}) {
+            bench->Args({size, enemies});
+        }
+    }
+}
+
+void BM_PaintEvent(benchmark::State &state) {
+    MainWindow window(benchLevel(static_cast<int>(state.range(0))), static_cast<int>(state.range(1)));
+    QImage image(window.size(), QImage::Format_ARGB32_Premultiplied);
+
+    for (auto _ : state) {
+        window.render(&image);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations()); // Frames per second
+}
+BENCHMARK(BM_PaintEvent)->Apply(paintArgs)->Unit(benchmark::kMillisecond);
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
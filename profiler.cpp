@@ -0,0 +1,130 @@
+#include "profiler.h"
+#include <algorithm>
+#include <cstdio>
+
+const char *profilePhaseName(ProfilePhase phase) {
+    switch (phase) {
+    case ProfilePhase::PacmanMove:
+        return "Pacman move";
+    case ProfilePhase::EnemyMove:
+        return "Enemy move";
+    case ProfilePhase::PelletCollision:
+        return "Pellet collision";
+    case ProfilePhase::EnemyCollision:
+        return "Enemy collision";
+    case ProfilePhase::PaintMaze:
+        return "Paint maze";
+    case ProfilePhase::PaintSprites:
+        return "Paint sprites";
+    case ProfilePhase::PaintHud:
+        return "Paint HUD";
+    case ProfilePhase::InputToPhoton:
+        return "Input to photon";
+    default:
+        return "Unknown";
+    }
+}
+
+Profiler::Profiler(int capacity)
+    : origin(std::chrono::steady_clock::now()), written(0) {
+    uint64_t size = 1;
+    while (size < static_cast<uint64_t>(std::max(capacity, 1))) {
+        size <<= 1;
+    }
+    mask = size - 1;
+    starts.reset(new std::atomic<uint64_t>[size]);
+    packed.reset(new std::atomic<uint64_t>[size]);
+    for (uint64_t i = 0; i < size; i++) {
+        starts[i].store(0, std::memory_order_relaxed);
+        packed[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t Profiler::now() const {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count());
+}
+
+void Profiler::record(ProfilePhase phase, uint64_t startNs, uint64_t endNs) {
+    uint64_t duration = std::min<uint64_t>(endNs - startNs, UINT32_MAX);
+    uint64_t index = written.load(std::memory_order_relaxed);
+    starts[index & mask].store(startNs, std::memory_order_relaxed);
+    packed[index & mask].store(duration | static_cast<uint64_t>(phase) << 32, std::memory_order_relaxed);
+    written.store(index + 1, std::memory_order_release);
+}
+
+std::vector<ProfileSample> Profiler::snapshot() const {
+    const uint64_t capacity = mask + 1;
+    uint64_t end = written.load(std::memory_order_acquire);
+    uint64_t begin = end > capacity ? end - capacity : 0;
+
+    std::vector<ProfileSample> samples;
+    samples.reserve(static_cast<size_t>(end - begin));
+    for (uint64_t i = begin; i < end; i++) {
+        uint64_t bits = packed[i & mask].load(std::memory_order_relaxed);
+        samples.push_back(ProfileSample{starts[i & mask].load(std::memory_order_relaxed),
+                                        static_cast<uint32_t>(bits), static_cast<ProfilePhase>(bits >> 32)});
+    }
+
+    // The writer may have lapped the oldest slots while they were being copied. It fills slot
+    // 'after' before counting it, and that slot holds sample after - capacity, so drop that one too
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t after = written.load(std::memory_order_relaxed);
+    uint64_t firstValid = after >= capacity ? after - capacity + 1 : 0;
+    if (firstValid > begin) {
+        samples.erase(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(std::min(firstValid, end) - begin));
+    }
+    return samples;
+}
+
+std::vector<PhaseStats> Profiler::stats() const {
+    const int phaseCount = static_cast<int>(ProfilePhase::Count);
+    std::vector<std::vector<uint32_t>> durations(phaseCount);
+    for (const ProfileSample &sample : snapshot()) {
+        if (sample.phase < ProfilePhase::Count)
+            durations[static_cast<int>(sample.phase)].push_back(sample.durationNs);
+    }
+
+    std::vector<PhaseStats> result(phaseCount);
+    for (int p = 0; p < phaseCount; p++) {
+        std::vector<uint32_t> &values = durations[p];
+        if (values.empty())
+            continue;
+        auto percentile = [&values](int percent) {
+            size_t rank = (values.size() - 1) * percent / 100;
+            std::nth_element(values.begin(), values.begin() + rank, values.end());
+            return values[rank];
+        };
+        result[p].count = static_cast<int>(values.size());
+        result[p].p50Ns = percentile(50);
+        result[p].p99Ns = percentile(99);
+    }
+    return result;
+}
+
+bool Profiler::writeChromeTrace(const std::string &path, std::string *error) const {
+    FILE *file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        if (error)
+            *error = "cannot open " + path;
+        return false;
+    }
+
+    // Complete ("X") events in microseconds; simulation, paint and input latency go on separate tracks
+    static const char *const categories[3] = {"simulation", "paint", "input"};
+    std::fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (const ProfileSample &sample : snapshot()) {
+        int track = sample.phase < ProfilePhase::PaintMaze ? 1 : (sample.phase < ProfilePhase::InputToPhoton ? 2 : 3);
+        std::fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                     first ? "" : ",\n", profilePhaseName(sample.phase), categories[track - 1],
+                     sample.startNs / 1000.0, sample.durationNs / 1000.0, track);
+        first = false;
+    }
+    std::fprintf(file, "\n],\"displayTimeUnit\":\"ns\"}\n");
+
+    bool ok = std::fclose(file) == 0;
+    if (!ok && error)
+        *error = "cannot write " + path;
+    return ok;
+}
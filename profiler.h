@@ -0,0 +1,82 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Timed sections of a frame: simulation phases from GameState::step, then the paint layers,
+// then InputToPhoton: from a key press to the first painted frame showing Pacman's turn
+enum class ProfilePhase : uint8_t {
+    PacmanMove,
+    EnemyMove,
+    PelletCollision,
+    EnemyCollision,
+    PaintMaze,
+    PaintSprites,
+    PaintHud,
+    InputToPhoton,
+    Count
+};
+
+const char *profilePhaseName(ProfilePhase phase);
+
+struct ProfileSample {
+    uint64_t startNs; // Since the profiler was created
+    uint32_t durationNs;
+    ProfilePhase phase;
+};
+
+struct PhaseStats {
+    int count = 0;
+    uint32_t p50Ns = 0;
+    uint32_t p99Ns = 0;
+};
+
+// Fixed-size ring of the most recent samples. One thread records; any thread may take
+// snapshots without locks: each slot is two atomic words, and slots the writer may have
+// overwritten while a snapshot was copying them are dropped from it
+class Profiler {
+public:
+    static const int defaultCapacity = 1 << 14; // Rounded up to a power of two
+
+    explicit Profiler(int capacity = defaultCapacity);
+
+    uint64_t now() const; // Nanoseconds since construction
+    void record(ProfilePhase phase, uint64_t startNs, uint64_t endNs);
+
+    std::vector<ProfileSample> snapshot() const; // Oldest first
+    std::vector<PhaseStats> stats() const; // Indexed by ProfilePhase, over the samples still in the ring
+    bool writeChromeTrace(const std::string &path, std::string *error = nullptr) const; // trace-event JSON
+
+private:
+    std::chrono::steady_clock::time_point origin;
+    uint64_t mask;
+    std::unique_ptr<std::atomic<uint64_t>[]> starts;
+    std::unique_ptr<std::atomic<uint64_t>[]> packed; // Duration in the low 32 bits, phase above
+    std::atomic<uint64_t> written; // Total samples ever recorded
+};
+
+// Records the lifetime of the scope as one sample; a null profiler makes it a no-op
+class ScopedTimer {
+public:
+    ScopedTimer(Profiler *profiler, ProfilePhase phase)
+        : profiler(profiler), phase(phase), startNs(profiler ? profiler->now() : 0) {}
+    ~ScopedTimer() {
+        if (profiler)
+            profiler->record(phase, startNs, profiler->now());
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    Profiler *profiler;
+    ProfilePhase phase;
+    uint64_t startNs;
+};
+
+#endif // PROFILER_H
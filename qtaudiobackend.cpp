@@ -0,0 +1,113 @@
+#include "qtaudiobackend.h"
+#include <QAudioFormat>
+#include <QMetaObject>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+#include <QAudioDevice>
+#include <QAudioSink>
+#include <QMediaDevices>
+#else
+#include <QAudioDeviceInfo>
+#include <QAudioOutput>
+#endif
+
+QtAudioBackend::QtAudioBackend() : readPosition(0), writePosition(0), closing(false) {}
+
+QtAudioBackend::~QtAudioBackend() {
+    close();
+}
+
+bool QtAudioBackend::open(int sampleRate, std::string *error) {
+    QAudioFormat format;
+    format.setSampleRate(sampleRate);
+    format.setChannelCount(1);
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    format.setSampleFormat(QAudioFormat::Int16);
+    QAudioDevice output = QMediaDevices::defaultAudioOutput();
+    if (output.isNull() || !output.isFormatSupported(format)) {
+#else
+    format.setSampleSize(16);
+    format.setCodec("audio/pcm");
+    format.setByteOrder(QAudioFormat::LittleEndian);
+    format.setSampleType(QAudioFormat::SignedInt);
+    QAudioDeviceInfo output = QAudioDeviceInfo::defaultOutputDevice();
+    if (output.isNull() || !output.isFormatSupported(format)) {
+#endif
+        if (error)
+            *error = "no audio output device for 16-bit mono PCM";
+        return false;
+    }
+
+    readPosition.store(0, std::memory_order_relaxed);
+    writePosition.store(0, std::memory_order_relaxed);
+    closing.store(false, std::memory_order_relaxed);
+    device.reset(new RingDevice(this));
+    device->open(QIODevice::ReadOnly);
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    sink.reset(new QAudioSink(output, format));
+#else
+    sink.reset(new QAudioOutput(output, format));
+#endif
+    sink->setBufferSize(AudioEngine::blockFrames * 2 * 4); // Four mixer blocks in the device
+    sink->start(device.get());
+    return true;
+}
+
+void QtAudioBackend::write(const int16_t *samples, int count) {
+    // Wait for room; the device drains a block every ~12 ms
+    uint32_t position = writePosition.load(std::memory_order_relaxed);
+    while (position + count - readPosition.load(std::memory_order_acquire) > static_cast<uint32_t>(ringFrames)) {
+        if (closing.load(std::memory_order_relaxed))
+            return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    for (int i = 0; i < count; i++) {
+        ring[(position + i) % ringFrames] = samples[i];
+    }
+    writePosition.store(position + count, std::memory_order_release);
+}
+
+void QtAudioBackend::close() {
+    closing.store(true, std::memory_order_relaxed);
+    if (sink)
+        sink->stop();
+    sink.reset();
+    device.reset();
+}
+
+void QtAudioBackend::suspend() {
+    // The device keeps polling for data while started, so an idle mixer is only silent once the
+    // device itself is suspended. The sink lives on the GUI thread: post the call there
+    while (readPosition.load(std::memory_order_acquire) != writePosition.load(std::memory_order_relaxed)) {
+        if (closing.load(std::memory_order_relaxed))
+            return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    auto *target = sink.get();
+    if (target)
+        QMetaObject::invokeMethod(target, [target] { target->suspend(); }, Qt::QueuedConnection);
+}
+
+void QtAudioBackend::resume() {
+    auto *target = sink.get();
+    if (target)
+        QMetaObject::invokeMethod(target, [target] { target->resume(); }, Qt::QueuedConnection);
+}
+
+qint64 QtAudioBackend::RingDevice::readData(char *data, qint64 maxSize) {
+    // Always hand back a full buffer: an underrun plays silence rather than stalling the device
+    const int wanted = static_cast<int>(maxSize / 2);
+    uint32_t position = owner->readPosition.load(std::memory_order_relaxed);
+    int available = static_cast<int>(owner->writePosition.load(std::memory_order_acquire) - position);
+    int count = std::min(wanted, available);
+    int16_t *out = reinterpret_cast<int16_t *>(data);
+    for (int i = 0; i < count; i++) {
+        out[i] = owner->ring[(position + i) % ringFrames];
+    }
+    std::memset(out + count, 0, static_cast<size_t>(wanted - count) * 2);
+    owner->readPosition.store(position + count, std::memory_order_release);
+    return static_cast<qint64>(wanted) * 2;
+}
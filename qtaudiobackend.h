@@ -0,0 +1,56 @@
+#ifndef QTAUDIOBACKEND_H
+#define QTAUDIOBACKEND_H
+
+#include "audio.h"
+#include <QIODevice>
+#include <atomic>
+#include <memory>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+class QAudioSink;
+#else
+class QAudioOutput;
+#endif
+
+// Feeds the mixer to the default sound device through Qt Multimedia. The device pulls from a
+// lock-free ring that the mixer thread fills; write() waits while the ring is full, which
+// paces the mixer to the device. The ring is kept short so a sound starts within a few blocks
+class QtAudioBackend : public AudioBackend {
+public:
+    static const int ringFrames = 2048; // About 93 ms at 22050 Hz
+
+    QtAudioBackend();
+    ~QtAudioBackend() override;
+    bool open(int sampleRate, std::string *error) override; // On the GUI thread
+    void write(const int16_t *samples, int count) override;
+    void close() override; // On the GUI thread
+    void suspend() override; // Lets the ring play out, then stops the device from pulling
+    void resume() override;
+
+private:
+    class RingDevice : public QIODevice {
+    public:
+        explicit RingDevice(QtAudioBackend *owner) : owner(owner) {}
+        bool isSequential() const override { return true; }
+
+    protected:
+        qint64 readData(char *data, qint64 maxSize) override;
+        qint64 writeData(const char *, qint64) override { return -1; }
+
+    private:
+        QtAudioBackend *owner;
+    };
+
+    int16_t ring[ringFrames];
+    std::atomic<uint32_t> readPosition; // Frames consumed by the device
+    std::atomic<uint32_t> writePosition; // Frames produced by the mixer
+    std::atomic<bool> closing;
+    std::unique_ptr<RingDevice> device;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    std::unique_ptr<QAudioSink> sink;
+#else
+    std::unique_ptr<QAudioOutput> sink;
+#endif
+};
+
+#endif // QTAUDIOBACKEND_H
@@ -0,0 +1,182 @@
+#include "replay.h"
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include "varint.h"
+
+namespace {
+
+const char replayMagic[4] = {'P', 'M', 'R', '1'};
+
+bool fail(std::string *error, const std::string &message) {
+    if (error)
+        *error = message;
+    return false;
+}
+
+} // namespace
+
+void ReplayRecorder::begin(const GameState &game) {
+    bytes.assign(replayMagic, replayMagic + 4);
+    writeVarint(bytes, game.seed);
+    writeVarint(bytes, static_cast<uint64_t>(game.enemyCount()));
+    writeVarint(bytes, static_cast<uint64_t>(game.ghostPolicy));
+    writeVarint(bytes, game.ghostSeparation ? 1 : 0);
+    writeVarint(bytes, static_cast<uint64_t>(game.activeRadius > 0 ? game.activeRadius : 0));
+    writeVarint(bytes, static_cast<uint64_t>(game.getTickRate()));
+
+    // Mazes are mostly long runs of walls and dots, so the level compresses well as runs
+    const Level &level = game.getLevel();
+    writeVarint(bytes, static_cast<uint64_t>(level.width));
+    writeVarint(bytes, static_cast<uint64_t>(level.height));
+    for (size_t i = 0; i < level.cells.size();) {
+        size_t run = 1;
+        while (i + run < level.cells.size() && level.cells[i + run] == level.cells[i])
+            run++;
+        bytes.push_back(static_cast<uint8_t>(level.cells[i]));
+        writeVarint(bytes, run);
+        i += run;
+    }
+
+    lastTick = game.tick;
+    recording = true;
+}
+
+void ReplayRecorder::record(const GameState &game, Input input) {
+    if (!recording || input == Input::None)
+        return;
+
+    // Pressing the direction that is already buffered changes nothing
+    PacmanState probe = game.pacman;
+    probe.setDirection(input);
+    if (probe.nextDx == game.pacman.nextDx && probe.nextDy == game.pacman.nextDy)
+        return;
+
+    uint64_t tick = game.tick + 1; // The tick this input is applied on
+    writeVarint(bytes, (tick - lastTick) << 2 | static_cast<uint64_t>(static_cast<int>(input) - 1));
+    lastTick = tick;
+}
+
+void ReplayRecorder::finish(const GameState &game) {
+    if (!recording)
+        return;
+    writeVarint(bytes, 0);
+    writeVarint(bytes, game.tick);
+    writeVarint(bytes, static_cast<uint64_t>(game.score));
+    writeVarint(bytes, static_cast<uint64_t>(game.lives > 0 ? game.lives : 0));
+    recording = false;
+}
+
+bool ReplayRecorder::save(const std::string &path) const {
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    file.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return static_cast<bool>(file);
+}
+
+bool ReplayPlayer::load(const std::string &path, std::string *error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return fail(error, "cannot open " + path);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return parse(data, error);
+}
+
+bool ReplayPlayer::parse(const std::vector<uint8_t> &data, std::string *error) {
+    if (data.size() < 4 || std::memcmp(data.data(), replayMagic, 4) != 0)
+        return fail(error, "not a replay file");
+
+    size_t pos = 4;
+    uint64_t values[8];
+    for (uint64_t &value : values) {
+        if (!readVarint(data, pos, value))
+            return fail(error, "truncated replay header");
+    }
+    seed = values[0];
+    if (values[1] > static_cast<uint64_t>(GameState::maxEnemyCount))
+        return fail(error, "bad enemy count in replay");
+    enemyCount = static_cast<int>(values[1]);
+    if (values[2] > static_cast<uint64_t>(GhostPolicy::Personalities))
+        return fail(error, "bad ghost policy in replay");
+    ghostPolicy = static_cast<GhostPolicy>(values[2]);
+    if (values[3] > 1)
+        return fail(error, "bad ghost separation flag in replay");
+    ghostSeparation = values[3] != 0;
+    if (values[4] > static_cast<uint64_t>(INT_MAX))
+        return fail(error, "bad active radius in replay");
+    activeRadius = static_cast<int>(values[4]);
+    if (values[5] == 0 || values[5] > static_cast<uint64_t>(GameState::maxTickRate))
+        return fail(error, "bad tick rate in replay");
+    tickRate = static_cast<int>(values[5]);
+    level.width = static_cast<int>(values[6]);
+    level.height = static_cast<int>(values[7]);
+    if (!isSupportedLevelSize(values[6], values[7]))
+        return fail(error, "bad level size in replay");
+
+    const size_t cellCount = static_cast<size_t>(level.width) * level.height;
+    level.cells.clear();
+    level.cells.reserve(cellCount);
+    while (level.cells.size() < cellCount) {
+        uint64_t run;
+        if (pos >= data.size())
+            return fail(error, "truncated level in replay");
+        char cell = static_cast<char>(data[pos++]);
+        if (!readVarint(data, pos, run) || run == 0 || run > cellCount - level.cells.size())
+            return fail(error, "corrupt level run in replay");
+        level.cells.insert(level.cells.end(), run, cell);
+    }
+
+    events.clear();
+    uint64_t tick = 0;
+    while (true) {
+        uint64_t code;
+        if (!readVarint(data, pos, code))
+            return fail(error, "replay ends without a footer");
+        if (code == 0)
+            break;
+        tick += code >> 2;
+        events.push_back(Event{tick, static_cast<Input>((code & 3) + 1)});
+    }
+
+    uint64_t score, lives;
+    if (!readVarint(data, pos, finalTick) || !readVarint(data, pos, score) || !readVarint(data, pos, lives))
+        return fail(error, "truncated replay footer");
+    finalScore = static_cast<int>(score);
+    finalLives = static_cast<int>(lives);
+    nextEvent = 0;
+    return true;
+}
+
+GameState ReplayPlayer::createGame() const {
+    GameState game(level, seed, enemyCount);
+    game.ghostPolicy = ghostPolicy;
+    game.ghostSeparation = ghostSeparation;
+    game.activeRadius = activeRadius;
+    game.setTickRate(tickRate);
+    game.reset();
+    return game;
+}
+
+Input ReplayPlayer::inputFor(const GameState &game) {
+    if (nextEvent < events.size() && events[nextEvent].tick == game.tick + 1)
+        return events[nextEvent++].input;
+    return Input::None;
+}
+
+bool ReplayPlayer::matches(const GameState &game) const {
+    return game.tick == finalTick && game.score == finalScore && (game.lives > 0 ? game.lives : 0) == finalLives;
+}
+
+bool verifyReplay(ReplayPlayer &player, GameState *finalState) {
+    player.rewind();
+    GameState game = player.createGame();
+    while (!player.atEnd(game)) {
+        game.step(player.inputFor(game));
+    }
+    bool ok = player.matches(game);
+    if (finalState)
+        *finalState = game;
+    return ok;
+}
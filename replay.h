@@ -0,0 +1,70 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "gamestate.h"
+
+// Replay file layout (all integers are LEB128 varints):
+//   "PMR1", seed, enemy count, ghost policy (GhostPolicy value), ghost separation (0 or 1),
+//   active radius (0 = everything moves), tick rate, level width, level height,
+//   level cells as (character byte, run length) pairs,
+//   events: ((ticks since previous event) << 2 | direction) with direction 0..3 = Up, Down, Left, Right,
+//   0 as end marker, then final tick, score and lives for verification.
+// Only inputs that change Pacman's buffered direction are stored, so idle stretches cost nothing.
+
+class ReplayRecorder {
+public:
+    void begin(const GameState &game); // Call right after GameState::reset
+    void record(const GameState &game, Input input); // Call right before GameState::step(input)
+    void finish(const GameState &game); // Append the final tick/score/lives footer
+    bool save(const std::string &path) const;
+    const std::vector<uint8_t> &data() const { return bytes; }
+    bool isRecording() const { return recording; }
+
+private:
+    std::vector<uint8_t> bytes;
+    uint64_t lastTick = 0;
+    bool recording = false;
+};
+
+class ReplayPlayer {
+public:
+    bool load(const std::string &path, std::string *error = nullptr);
+    bool parse(const std::vector<uint8_t> &data, std::string *error = nullptr);
+
+    GameState createGame() const; // Fresh game with the recorded seed, level and settings
+    void rewind() { nextEvent = 0; }
+    Input inputFor(const GameState &game); // Input to pass to the next step(), in tick order
+    bool atEnd(const GameState &game) const { return game.isOver() || game.tick >= finalTick; }
+    bool matches(const GameState &game) const; // Same final tick, score and lives as recorded
+
+    uint64_t getFinalTick() const { return finalTick; }
+    int getFinalScore() const { return finalScore; }
+    int getFinalLives() const { return finalLives; }
+
+private:
+    struct Event {
+        uint64_t tick;
+        Input input;
+    };
+
+    uint64_t seed = 0;
+    int enemyCount = 0;
+    GhostPolicy ghostPolicy = GhostPolicy::Random;
+    bool ghostSeparation = false;
+    int activeRadius = 0;
+    int tickRate = GameState::defaultTickRate;
+    Level level;
+    std::vector<Event> events;
+    size_t nextEvent = 0;
+    uint64_t finalTick = 0;
+    int finalScore = 0;
+    int finalLives = 0;
+};
+
+// Re-run a replay at maximum speed without rendering; returns whether it reproduced the recorded result
+bool verifyReplay(ReplayPlayer &player, GameState *finalState = nullptr);
+
+#endif // REPLAY_H
@@ -0,0 +1,35 @@
+// replaytool.cpp - re-runs recorded games at maximum speed and checks they reproduce exactly
+#include <cstdio>
+#include <string>
+#include "replay.h"
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::printf("Usage: %s REPLAY...\n", argv[0]);
+        return 1;
+    }
+
+    int failures = 0;
+    for (int i = 1; i < argc; i++) {
+        ReplayPlayer player;
+        std::string error;
+        if (!player.load(argv[i], &error)) {
+            std::fprintf(stderr, "%s: %s\n", argv[i], error.c_str());
+            failures++;
+            continue;
+        }
+
+        GameState game;
+        bool ok = verifyReplay(player, &game);
+        std::printf("%s: %s  tick %llu  score %d  lives %d", argv[i], ok ? "OK" : "MISMATCH",
+                    static_cast<unsigned long long>(game.tick), game.score, game.lives);
+        if (!ok) {
+            std::printf("  (recorded tick %llu  score %d  lives %d)",
+                        static_cast<unsigned long long>(player.getFinalTick()), player.getFinalScore(),
+                        player.getFinalLives());
+            failures++;
+        }
+        std::printf("\n");
+    }
+    return failures == 0 ? 0 : 2;
+}
@@ -0,0 +1,562 @@
+// server.cpp - authoritative multi-player server: one shared maze, clients on a local socket, one
+// broadcast delta per tick. Can also run a swarm of bot clients against itself or another server
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "arena.h"
+#include "levelgen.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // SIGPIPE is ignored instead
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct ServerOptions {
+    int port = 7777;
+    std::string socketPath; // Unix socket instead of TCP on 127.0.0.1
+    int tickRate = GameState::defaultTickRate;
+    double duration = 0; // Seconds, 0 = until interrupted
+    int enemies = GameState::defaultEnemyCount;
+    GhostPolicy ghostPolicy = GhostPolicy::Random;
+    uint64_t seed = 1;
+    std::string levelPath;
+    int generateWidth = 0;
+    int generateHeight = 0;
+    int bots = 0;
+    bool connectOnly = false; // Only run the bots, against a server that is already running
+    bool quiet = false; // No per-second lines, only the summary
+};
+
+const size_t maxBacklog = 1 << 20; // Clients with this much unsent data are too slow and get dropped
+const size_t maxPendingInput = 1 << 16;
+
+std::atomic<bool> stopRequested(false);
+
+void requestStop(int) {
+    stopRequested = true;
+}
+
+void printUsage(const char *program) {
+    std::printf("Usage: %s [options]\n"
+                "  --port N           TCP port on 127.0.0.1 (default 7777)\n"
+                "  --unix PATH        Listen on a Unix socket instead\n"
+                "  --tick-rate N      Simulation steps per second (default %d)\n"
+                "  --duration S       Stop after S seconds (default: until interrupted)\n"
+                "  --enemies N        Number of enemies (default %d)\n"
+                "  --ghost-ai NAME    random, chase or personalities (default random)\n"
+                "  --seed N           World seed (default 1)\n"
+                "  --level PATH       Level file instead of the built-in maze\n"
+                "  --generate WxH     Generated WxH level, from the seed\n"
+                "  --bots N           Also connect N bot clients that play random moves and check checksums\n"
+                "  --connect          Run only the bots, against a server that is already listening\n"
+                "  --quiet            Print only the summary\n",
+                program, GameState::defaultTickRate, GameState::defaultEnemyCount);
+}
+
+bool parseOptions(int argc, char *argv[], ServerOptions &options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--connect") {
+            options.connectOnly = true;
+            continue;
+        }
+        if (arg == "--quiet") {
+            options.quiet = true;
+            continue;
+        }
+        if (arg == "--help" || arg == "-h" || i + 1 >= argc)
+            return false;
+        std::string value = argv[++i];
+        if (arg == "--port") {
+            options.port = std::atoi(value.c_str());
+        } else if (arg == "--unix") {
+            options.socketPath = value;
+        } else if (arg == "--tick-rate") {
+            options.tickRate = std::max(1, std::atoi(value.c_str()));
+            if (options.tickRate > GameState::maxTickRate)
+                options.tickRate = GameState::maxTickRate;
+        } else if (arg == "--duration") {
+            options.duration = std::max(0.0, std::atof(value.c_str()));
+        } else if (arg == "--enemies") {
+            options.enemies = std::max(0, std::atoi(value.c_str()));
+        } else if (arg == "--ghost-ai") {
+            options.ghostPolicy = value == "chase" ? GhostPolicy::ChaseScatter
+                : value == "personalities" ? GhostPolicy::Personalities : GhostPolicy::Random;
+        } else if (arg == "--seed") {
+            options.seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--level") {
+            options.levelPath = value;
+        } else if (arg == "--generate") {
+            size_t x = value.find('x');
+            options.generateWidth = std::atoi(value.c_str());
+            options.generateHeight = x == std::string::npos ? options.generateWidth : std::atoi(value.c_str() + x + 1);
+            if (options.generateWidth <= 0 || options.generateHeight <= 0)
+                return false;
+        } else if (arg == "--bots") {
+            options.bots = std::max(0, std::atoi(value.c_str()));
+        } else {
+            return false;
+        }
+    }
+    return options.port > 0 && options.port < 65536 && (!options.connectOnly || options.bots > 0);
+}
+
+bool fail(std::string *error, const std::string &message) {
+    if (error)
+        *error = message + ": " + std::strerror(errno);
+    return false;
+}
+
+void setNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+// Fills 'address' for the configured endpoint; returns its length
+socklen_t endpoint(const ServerOptions &options, sockaddr_storage &address) {
+    std::memset(&address, 0, sizeof(address));
+    if (!options.socketPath.empty()) {
+        sockaddr_un *local = reinterpret_cast<sockaddr_un *>(&address);
+        local->sun_family = AF_UNIX;
+        std::strncpy(local->sun_path, options.socketPath.c_str(), sizeof(local->sun_path) - 1);
+        return sizeof(sockaddr_un);
+    }
+    sockaddr_in *inet = reinterpret_cast<sockaddr_in *>(&address);
+    inet->sin_family = AF_INET;
+    inet->sin_port = htons(static_cast<uint16_t>(options.port));
+    inet->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return sizeof(sockaddr_in);
+}
+
+int openSocket(const ServerOptions &options, bool listening, std::string *error) {
+    sockaddr_storage address;
+    socklen_t length = endpoint(options, address);
+    int fd = socket(address.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        fail(error, "socket");
+        return -1;
+    }
+    if (listening) {
+        int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        if (!options.socketPath.empty())
+            unlink(options.socketPath.c_str());
+        if (bind(fd, reinterpret_cast<sockaddr *>(&address), length) != 0 || listen(fd, SOMAXCONN) != 0) {
+            fail(error, "cannot listen");
+            close(fd);
+            return -1;
+        }
+    } else if (connect(fd, reinterpret_cast<sockaddr *>(&address), length) != 0) {
+        fail(error, "cannot connect");
+        close(fd);
+        return -1;
+    }
+    if (options.socketPath.empty()) {
+        int yes = 1; // Deltas are small and latency matters more than packet count
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    }
+    setNonBlocking(fd);
+    return fd;
+}
+
+// Appends everything readable; false when the peer closed or the socket failed
+bool receive(int fd, std::vector<uint8_t> &in, uint64_t &bytes) {
+    uint8_t buffer[65536];
+    for (;;) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            in.insert(in.end(), buffer, buffer + n);
+            bytes += static_cast<uint64_t>(n);
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return true;
+        if (n < 0 && errno == EINTR)
+            continue;
+        return false;
+    }
+}
+
+// Sends as much of out[pos..] as the socket takes; false when the socket failed
+bool flush(int fd, std::vector<uint8_t> &out, size_t &pos, uint64_t &bytes) {
+    while (pos < out.size()) {
+        ssize_t n = send(fd, out.data() + pos, out.size() - pos, MSG_NOSIGNAL);
+        if (n > 0) {
+            pos += static_cast<size_t>(n);
+            bytes += static_cast<uint64_t>(n);
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    if (pos == out.size()) {
+        out.clear();
+        pos = 0;
+    } else if (pos > out.size() / 2) {
+        out.erase(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(pos));
+        pos = 0;
+    }
+    return true;
+}
+
+// p50/p99/max of 'samples', reordering them
+void percentiles(std::vector<int> &samples, int &p50, int &p99, int &max) {
+    p50 = p99 = max = 0;
+    if (samples.empty())
+        return;
+    auto at = [&samples](double q) {
+        auto nth = samples.begin() + static_cast<std::ptrdiff_t>(q * (samples.size() - 1));
+        std::nth_element(samples.begin(), nth, samples.end());
+        return *nth;
+    };
+    p50 = at(0.50);
+    p99 = at(0.99);
+    max = *std::max_element(samples.begin(), samples.end());
+}
+
+struct Client {
+    int fd = -1;
+    int playerId = -1;
+    std::vector<uint8_t> in, out;
+    size_t outPos = 0;
+    bool closed = false;
+};
+
+struct ServerTotals {
+    uint64_t ticks = 0;
+    uint64_t lateTicks = 0; // Ticks that started more than one period late
+    uint64_t bytesIn = 0, bytesOut = 0;
+    uint64_t messageBytes = 0; // Delta and snapshot payloads, before fan-out
+    uint64_t clientTicks = 0; // Sum of the client count over all ticks
+    uint64_t accepted = 0, dropped = 0;
+    int peakClients = 0;
+    std::vector<int> tickMicros;
+};
+
+void runServer(const ServerOptions &options, Arena &arena, int listener, ServerTotals &totals) {
+    std::vector<Client> clients;
+    std::vector<pollfd> fds;
+    std::vector<uint8_t> payload, framed;
+    ArenaMessage type;
+
+    const Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / options.tickRate));
+    const Clock::time_point start = Clock::now();
+    const Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.duration));
+    Clock::time_point nextTick = start + period;
+    Clock::time_point nextReport = start + std::chrono::seconds(1);
+    std::vector<int> windowMicros;
+    uint64_t windowIn = totals.bytesIn, windowOut = totals.bytesOut, windowMessageBytes = 0, windowTicks = 0;
+
+    while (!stopRequested && (options.duration <= 0 || Clock::now() < end)) {
+        fds.assign(1, pollfd{listener, POLLIN, 0});
+        for (const Client &client : clients) {
+            fds.push_back(pollfd{client.fd, static_cast<short>(POLLIN | (client.out.empty() ? 0 : POLLOUT)), 0});
+        }
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(nextTick - Clock::now()).count();
+        poll(fds.data(), fds.size(), static_cast<int>(std::max<long long>(0, wait)));
+
+        for (size_t i = 0; i < clients.size(); i++) {
+            Client &client = clients[i];
+            const short revents = fds[i + 1].revents;
+            if (revents & (POLLIN | POLLHUP | POLLERR)) {
+                client.closed = !receive(client.fd, client.in, totals.bytesIn);
+                // Only the latest input of each client counts for the coming tick
+                size_t pos = 0;
+                std::string error;
+                while (takeMessage(client.in, pos, type, payload, &error)) {
+                    if (type == ArenaMessage::Input && payload.size() == 1 && payload[0] <= static_cast<uint8_t>(Input::Right))
+                        arena.setInput(client.playerId, static_cast<Input>(payload[0]));
+                }
+                client.in.erase(client.in.begin(), client.in.begin() + static_cast<std::ptrdiff_t>(pos));
+                if (!error.empty() || client.in.size() > maxPendingInput)
+                    client.closed = true;
+            }
+            if ((revents & POLLOUT) && !flush(client.fd, client.out, client.outPos, totals.bytesOut))
+                client.closed = true;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            for (int fd; (fd = accept(listener, nullptr, nullptr)) >= 0;) {
+                setNonBlocking(fd);
+                if (options.socketPath.empty()) {
+                    int yes = 1;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+                }
+                Client client;
+                client.fd = fd;
+                client.playerId = arena.addPlayer();
+                arena.encodeWelcome(client.playerId, payload);
+                appendMessage(client.out, ArenaMessage::Welcome, payload);
+                client.closed = !flush(client.fd, client.out, client.outPos, totals.bytesOut);
+                clients.push_back(std::move(client));
+                totals.accepted++;
+            }
+        }
+
+        Clock::time_point now = Clock::now();
+        if (now >= nextTick) {
+            // One step and one encoded message for everybody, whatever the client count
+            Clock::time_point tickStart = now;
+            arena.step();
+            ArenaMessage kind = arena.encodeDelta(payload) ? ArenaMessage::Delta : ArenaMessage::Snapshot;
+            framed.clear();
+            appendMessage(framed, kind, payload);
+            for (Client &client : clients) {
+                if (client.closed)
+                    continue;
+                if (client.out.size() - client.outPos > maxBacklog) {
+                    client.closed = true;
+                    totals.dropped++;
+                    continue;
+                }
+                client.out.insert(client.out.end(), framed.begin(), framed.end());
+                if (!flush(client.fd, client.out, client.outPos, totals.bytesOut))
+                    client.closed = true;
+            }
+            int micros = static_cast<int>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - tickStart).count());
+            windowMicros.push_back(micros);
+            totals.tickMicros.push_back(micros);
+            totals.ticks++;
+            totals.clientTicks += static_cast<uint64_t>(arena.playerCount());
+            totals.messageBytes += framed.size();
+            windowMessageBytes += framed.size();
+            windowTicks++;
+
+            nextTick += period;
+            if (now - nextTick > period) {
+                totals.lateTicks++;
+                nextTick = now + period; // Do not try to catch up with a burst of ticks
+            }
+        }
+
+        for (Client &client : clients) {
+            if (client.closed) {
+                arena.removePlayer(client.playerId);
+                close(client.fd);
+            }
+        }
+        clients.erase(std::remove_if(clients.begin(), clients.end(), [](const Client &c) { return c.closed; }),
+                      clients.end());
+        totals.peakClients = std::max(totals.peakClients, static_cast<int>(clients.size()));
+
+        if (now >= nextReport) {
+            int p50, p99, max;
+            percentiles(windowMicros, p50, p99, max);
+            if (!options.quiet) {
+                std::printf("%6.1fs  clients %4zu  tick p50 %5d us  p99 %5d us  max %5d us  %6.0f B/tick  out %8.1f kB/s  in %6.1f kB/s\n",
+                            std::chrono::duration<double>(now - start).count(), clients.size(), p50, p99, max,
+                            windowTicks ? static_cast<double>(windowMessageBytes) / windowTicks : 0.0,
+                            (totals.bytesOut - windowOut) / 1024.0, (totals.bytesIn - windowIn) / 1024.0);
+                std::fflush(stdout);
+            }
+            windowMicros.clear();
+            windowIn = totals.bytesIn;
+            windowOut = totals.bytesOut;
+            windowMessageBytes = 0;
+            windowTicks = 0;
+            nextReport += std::chrono::seconds(1);
+        }
+    }
+
+    for (const Client &client : clients) {
+        close(client.fd);
+    }
+}
+
+struct BotTotals {
+    int connected = 0;
+    int failed = 0; // Could not connect, or received a corrupt stream
+    int disconnected = 0; // Closed by the server
+    uint64_t messages = 0;
+    uint64_t bytesIn = 0;
+    uint64_t inputs = 0;
+    uint64_t checksumsMatched = 0;
+    uint64_t checksumMismatches = 0;
+};
+
+struct Bot {
+    int fd = -1;
+    std::vector<uint8_t> in, out;
+    size_t outPos = 0;
+    ArenaMirror mirror;
+    bool closed = false;
+};
+
+// Bots keep a full mirror of the arena, so every checksum the server sends is verified
+void runBots(const ServerOptions &options, BotTotals &totals) {
+    std::vector<Bot> bots(options.bots);
+    for (Bot &bot : bots) {
+        std::string error;
+        bot.fd = openSocket(options, false, &error);
+        if (bot.fd < 0) {
+            if (totals.failed++ == 0)
+                std::fprintf(stderr, "bot: %s\n", error.c_str());
+            bot.closed = true;
+        } else {
+            totals.connected++;
+        }
+    }
+
+    Rng rng(options.seed ^ 0x9E3779B97F4A7C15ULL);
+    std::vector<pollfd> fds;
+    std::vector<uint8_t> payload;
+    ArenaMessage type;
+    const Clock::time_point end = Clock::now()
+        + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.duration));
+    while (!stopRequested && (options.duration <= 0 || Clock::now() < end)) {
+        fds.clear();
+        for (const Bot &bot : bots) {
+            fds.push_back(pollfd{bot.closed ? -1 : bot.fd, static_cast<short>(POLLIN | (bot.out.empty() ? 0 : POLLOUT)), 0});
+        }
+        if (poll(fds.data(), fds.size(), 50) <= 0)
+            continue;
+
+        for (size_t i = 0; i < bots.size(); i++) {
+            Bot &bot = bots[i];
+            if (bot.closed)
+                continue;
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                if (!receive(bot.fd, bot.in, totals.bytesIn)) {
+                    bot.closed = true;
+                    totals.disconnected++;
+                }
+                size_t pos = 0;
+                std::string error;
+                while (error.empty() && takeMessage(bot.in, pos, type, payload, &error)) {
+                    totals.messages++;
+                    if (!bot.mirror.apply(type, payload, &error))
+                        break;
+                    // About every eighth tick, press a random direction
+                    if (!bot.closed && rng.bounded(8) == 0) {
+                        appendMessage(bot.out, ArenaMessage::Input,
+                                      {static_cast<uint8_t>(static_cast<int>(Input::Up) + rng.bounded(4))});
+                        totals.inputs++;
+                    }
+                }
+                bot.in.erase(bot.in.begin(), bot.in.begin() + static_cast<std::ptrdiff_t>(pos));
+                if (!error.empty()) {
+                    if (totals.failed++ == 0)
+                        std::fprintf(stderr, "bot %zu: %s\n", i, error.c_str());
+                    bot.closed = true;
+                }
+            }
+            uint64_t sent = 0;
+            if (!bot.closed && !bot.out.empty() && !flush(bot.fd, bot.out, bot.outPos, sent)) {
+                bot.closed = true;
+                totals.disconnected++;
+            }
+        }
+    }
+
+    for (Bot &bot : bots) {
+        if (bot.fd >= 0)
+            close(bot.fd);
+        totals.checksumsMatched += bot.mirror.checksumsMatched;
+        totals.checksumMismatches += bot.mirror.checksumMismatches;
+    }
+}
+
+void printBotTotals(const BotTotals &bots) {
+    std::printf("bots             %d connected, %d failed, %d disconnected, %llu messages, %.1f MB received, %llu inputs\n",
+                bots.connected, bots.failed, bots.disconnected, static_cast<unsigned long long>(bots.messages), bots.bytesIn / 1048576.0,
+                static_cast<unsigned long long>(bots.inputs));
+    std::printf("checksums        %llu matched, %llu mismatched\n",
+                static_cast<unsigned long long>(bots.checksumsMatched),
+                static_cast<unsigned long long>(bots.checksumMismatches));
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    ServerOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+
+    if (options.connectOnly) {
+        BotTotals bots;
+        runBots(options, bots);
+        printBotTotals(bots);
+        return bots.checksumMismatches == 0 && bots.failed == 0 ? 0 : 2;
+    }
+
+    Level level = defaultLevel();
+    if (!options.levelPath.empty()) {
+        std::string error;
+        if (!loadLevelFile(options.levelPath, level, &error)) {
+            std::fprintf(stderr, "Could not load level: %s\n", error.c_str());
+            return 1;
+        }
+    } else if (options.generateWidth > 0) {
+        level = generateLevel(options.generateWidth, options.generateHeight, options.seed);
+    }
+
+    Arena arena(level, options.seed, options.enemies);
+    arena.world.ghostPolicy = options.ghostPolicy;
+    arena.world.setTickRate(options.tickRate);
+    arena.world.reset();
+
+    std::string error;
+    int listener = openSocket(options, true, &error);
+    if (listener < 0) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    std::printf("listening on %s, %d ticks/s, %dx%d maze, %d enemies\n",
+                options.socketPath.empty() ? ("127.0.0.1:" + std::to_string(options.port)).c_str() : options.socketPath.c_str(),
+                options.tickRate, level.width, level.height, options.enemies);
+    std::fflush(stdout);
+
+    BotTotals bots;
+    std::thread botThread;
+    if (options.bots > 0)
+        botThread = std::thread(runBots, std::cref(options), std::ref(bots));
+
+    ServerTotals totals;
+    runServer(options, arena, listener, totals);
+    stopRequested = true;
+    if (botThread.joinable())
+        botThread.join();
+    close(listener);
+    if (!options.socketPath.empty())
+        unlink(options.socketPath.c_str());
+
+    int p50, p99, max;
+    percentiles(totals.tickMicros, p50, p99, max);
+    const double ticks = totals.ticks > 0 ? static_cast<double>(totals.ticks) : 1.0;
+    std::printf("ticks            %llu (%llu late), clients avg %.1f, peak %d, %llu accepted, %llu dropped as too slow\n",
+                static_cast<unsigned long long>(totals.ticks), static_cast<unsigned long long>(totals.lateTicks),
+                totals.clientTicks / ticks, totals.peakClients, static_cast<unsigned long long>(totals.accepted),
+                static_cast<unsigned long long>(totals.dropped));
+    std::printf("tick time        p50 %d us, p99 %d us, max %d us (step, encode and send)\n", p50, p99, max);
+    std::printf("bandwidth        %.1f B/tick per client, %.1f MB out, %.1f kB in\n", totals.messageBytes / ticks,
+                totals.bytesOut / 1048576.0, totals.bytesIn / 1024.0);
+    if (options.bots > 0)
+        printBotTotals(bots);
+    return bots.checksumMismatches == 0 ? 0 : 2;
+}
@@ -0,0 +1,49 @@
+#include "spatialhash.h"
+
+void SpatialHash::build(const int *x, const int *y, int count, int cellSize, int gridWidth) {
+    this->gridWidth = gridWidth;
+
+    // Power-of-two bucket count, about two buckets per entry, indexed by Fibonacci hashing
+    int bits = 1;
+    while ((1 << bits) < 2 * count && bits < 30) {
+        bits++;
+    }
+    shift = 64 - bits;
+    const int bucketCount = 1 << bits;
+
+    bucketStart.assign(bucketCount + 1, 0);
+    entries.resize(count);
+    entryCell.resize(count);
+    scratchBucket.resize(count);
+
+    for (int i = 0; i < count; i++) {
+        int cell = (y[i] / cellSize) * gridWidth + x[i] / cellSize;
+        uint32_t bucket = bucketOf(cell);
+        scratchBucket[i] = bucket;
+        bucketStart[bucket + 1]++;
+    }
+    for (int b = 0; b < bucketCount; b++) {
+        bucketStart[b + 1] += bucketStart[b];
+    }
+
+    // Place entries in index order, using each bucket's start as its fill cursor, then shift the
+    // cursors back; this keeps ascending index order inside every bucket
+    for (int i = 0; i < count; i++) {
+        int slot = bucketStart[scratchBucket[i]]++;
+        entries[slot] = i;
+        entryCell[slot] = (y[i] / cellSize) * gridWidth + x[i] / cellSize;
+    }
+    for (int b = bucketCount; b > 0; b--) {
+        bucketStart[b] = bucketStart[b - 1];
+    }
+    bucketStart[0] = 0;
+}
+
+bool SpatialHash::occupied(int row, int col, int ignore) const {
+    bool found = false;
+    forEachInCell(row, col, [&found, ignore](int index) {
+        found = index != ignore;
+        return !found;
+    });
+    return found;
+}
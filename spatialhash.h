@@ -0,0 +1,42 @@
+#ifndef SPATIALHASH_H
+#define SPATIALHASH_H
+
+#include <cstdint>
+#include <vector>
+
+// Uniform grid keyed on maze cells, stored as a hash so its size follows the number of
+// entries rather than the maze area. Rebuilt with a counting sort each time positions change:
+// no per-entry allocation, and entries within a cell stay in ascending index order
+class SpatialHash {
+public:
+    // Bucket every entry by the cell containing (x[i], y[i]); positions must lie inside the grid
+    void build(const int *x, const int *y, int count, int cellSize, int gridWidth);
+
+    // Calls visit(index) for the entries in the given cell, in ascending index order,
+    // until visit returns false
+    template <typename Visit>
+    void forEachInCell(int row, int col, Visit &&visit) const {
+        const int cell = row * gridWidth + col;
+        const uint32_t bucket = bucketOf(cell);
+        for (int k = bucketStart[bucket]; k < bucketStart[bucket + 1]; k++) {
+            if (entryCell[k] == cell && !visit(entries[k]))
+                return;
+        }
+    }
+
+    bool occupied(int row, int col, int ignore) const; // Any entry other than 'ignore' in the cell?
+
+private:
+    int gridWidth = 0;
+    int shift = 32;
+    std::vector<int> bucketStart; // Offsets into entries, one past the end for the last bucket
+    std::vector<int> entries; // Entry indices grouped by bucket
+    std::vector<int> entryCell; // Cell of each grouped entry, to skip other cells sharing the bucket
+    std::vector<uint32_t> scratchBucket; // Bucket of each entry during build
+
+    uint32_t bucketOf(int cell) const {
+        return static_cast<uint32_t>((static_cast<uint64_t>(static_cast<uint32_t>(cell)) * 0x9E3779B97F4A7C15ULL) >> shift);
+    }
+};
+
+#endif // SPATIALHASH_H
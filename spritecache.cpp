@@ -0,0 +1,94 @@
+#include "spritecache.h"
+#include <QPainter>
+#include <QImage>
+
+void SpriteCache::build(int cellSize, const QVector<QColor> &enemyColors, qreal devicePixelRatio) {
+    // Decode and resample the enemy image once instead of on every frame
+    QImage source(":/images/enemy.png");
+    if (!source.isNull()) {
+        int size = qRound(enemySize * devicePixelRatio);
+        source = source.scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation)
+                     .convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+
+    enemyFrames.clear();
+    for (const QColor &color : enemyColors) {
+        enemyFrames.append(makeEnemyFrame(source, color, devicePixelRatio));
+    }
+    frightenedFrame = makeEnemyFrame(source, Qt::blue, devicePixelRatio);
+
+    // Mouth opens towards the movement direction: right, left, down, up
+    const int startAngles[4] = {45, 225, 315, 135};
+    for (int d = 0; d < 4; d++) {
+        for (int f = 0; f < mouthFrames; f++) {
+            pacmanFrames[d][f] = makePacmanFrame(cellSize, startAngles[d], f * mouthStep, devicePixelRatio);
+        }
+    }
+    pacmanIdle = makePacmanFrame(cellSize, 0, 0, devicePixelRatio);
+}
+
+const QPixmap &SpriteCache::enemy(int index, bool frightened) const {
+    return frightened ? frightenedFrame : enemyFrames[index % enemyFrames.size()];
+}
+
+const QPixmap &SpriteCache::pacman(int dx, int dy, int mouthAngle) const {
+    int direction;
+    if (dx > 0) {
+        direction = 0;
+    } else if (dx < 0) {
+        direction = 1;
+    } else if (dy > 0) {
+        direction = 2;
+    } else if (dy < 0) {
+        direction = 3;
+    } else {
+        return pacmanIdle;
+    }
+    int frame = qBound(0, mouthAngle / mouthStep, mouthFrames - 1);
+    return pacmanFrames[direction][frame];
+}
+
+QPixmap SpriteCache::makeEnemyFrame(const QImage &source, const QColor &color, qreal devicePixelRatio) {
+    int size = qRound(enemySize * devicePixelRatio);
+    QImage frame(size, size, QImage::Format_ARGB32_Premultiplied);
+    frame.setDevicePixelRatio(devicePixelRatio);
+    frame.fill(Qt::transparent);
+
+    QPainter painter(&frame);
+    painter.setRenderHint(QPainter::Antialiasing);
+    if (source.isNull()) {
+        painter.setPen(Qt::NoPen);
+        painter.setBrush(color);
+        painter.drawEllipse(QPointF(enemySize / 2.0, enemySize / 2.0), 10, 10);
+    } else {
+        // Center the scaled image, then tint its opaque pixels with the enemy color
+        QPointF offset((size - source.width()) / (2.0 * devicePixelRatio),
+                       (size - source.height()) / (2.0 * devicePixelRatio));
+        QImage scaled = source;
+        scaled.setDevicePixelRatio(devicePixelRatio);
+        painter.drawImage(offset, scaled);
+        painter.setCompositionMode(QPainter::CompositionMode_SourceAtop);
+        QColor tint = color;
+        tint.setAlpha(128);
+        painter.fillRect(QRectF(0, 0, enemySize, enemySize), tint);
+    }
+    painter.end();
+    return QPixmap::fromImage(frame);
+}
+
+QPixmap SpriteCache::makePacmanFrame(int cellSize, int startAngle, int mouthAngle, qreal devicePixelRatio) {
+    int size = qRound(cellSize * devicePixelRatio);
+    QImage frame(size, size, QImage::Format_ARGB32_Premultiplied);
+    frame.setDevicePixelRatio(devicePixelRatio);
+    frame.fill(Qt::transparent);
+
+    QPainter painter(&frame);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setBrush(Qt::yellow);
+    painter.setPen(Qt::NoPen);
+    // A closed mouth is a full 360 degree pie, i.e. a circle
+    painter.drawPie(QRectF(0, 0, cellSize, cellSize),
+                    (startAngle - mouthAngle) * 16, (360 - 2 * mouthAngle) * 16);
+    painter.end();
+    return QPixmap::fromImage(frame);
+}
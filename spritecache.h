@@ -0,0 +1,31 @@
+#ifndef SPRITECACHE_H
+#define SPRITECACHE_H
+
+#include <QPixmap>
+#include <QColor>
+#include <QVector>
+
+// Pre-scaled, pre-tinted sprite frames built once so painting is plain blits
+class SpriteCache {
+public:
+    static const int enemySize = 30; // Enemy sprites are drawn 30x30 around their center
+    static const int mouthStep = 5; // Pacman's mouth opens/closes 5 degrees per frame
+    static const int maxMouthAngle = 45;
+    static const int mouthFrames = maxMouthAngle / mouthStep + 1;
+
+    void build(int cellSize, const QVector<QColor> &enemyColors, qreal devicePixelRatio);
+
+    const QPixmap &enemy(int index, bool frightened) const; // Colors repeat for larger enemy pools
+    const QPixmap &pacman(int dx, int dy, int mouthAngle) const;
+
+private:
+    QVector<QPixmap> enemyFrames; // One per enemy color
+    QPixmap frightenedFrame; // Shared blue frame while a power-up is active
+    QPixmap pacmanFrames[4][mouthFrames]; // Right, left, down, up for each mouth angle
+    QPixmap pacmanIdle; // Full circle when not moving
+
+    static QPixmap makeEnemyFrame(const QImage &source, const QColor &color, qreal devicePixelRatio);
+    static QPixmap makePacmanFrame(int cellSize, int startAngle, int mouthAngle, qreal devicePixelRatio);
+};
+
+#endif // SPRITECACHE_H
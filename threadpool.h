@@ -0,0 +1,47 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool: each worker pops from the back of its own deque and,
+// when that runs dry, steals from the front of the others
+class ThreadPool {
+public:
+    explicit ThreadPool(int threadCount = 0); // 0 = one thread per hardware core
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void submit(std::function<void()> task);
+    void wait(); // Block until every submitted task has finished
+    int size() const { return static_cast<int>(threads.size()); }
+
+private:
+    struct Worker {
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<unsigned> nextWorker; // Round-robin target for submit()
+    std::atomic<int> queued; // Tasks sitting in some deque
+    std::atomic<int> unfinished; // Tasks submitted but not finished yet
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp; // Signals idle workers that work arrived
+    std::condition_variable allDone; // Signals wait() that unfinished hit zero
+    bool stopping;
+
+    void run(int index);
+    bool takeTask(int index, std::function<void()> &task);
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,43 @@
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// LEB128 varints shared by the replay format and the arena protocol
+
+inline void writeVarint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// False when the input ends before the last byte or the value does not fit 64 bits
+inline bool readVarint(const std::vector<uint8_t> &in, size_t &pos, uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+        uint8_t byte = in[pos++];
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// Signed values as zigzag varints, so small negative numbers stay one byte
+inline void writeSignedVarint(std::vector<uint8_t> &out, int64_t value) {
+    writeVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+inline bool readSignedVarint(const std::vector<uint8_t> &in, size_t &pos, int64_t &value) {
+    uint64_t raw;
+    if (!readVarint(in, pos, raw))
+        return false;
+    value = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+    return true;
+}
+
+#endif // VARINT_H